@@ -5,11 +5,43 @@
 #include <queue>
 #include <limits>
 #include <ctime> // for the clock 
+#include <chrono> // host wall time for --time
+#include <charconv> // std::from_chars for the --input scanner
+#include <fstream>
+#include <cstring> // memcpy for the binary workload sections
+#include <algorithm>
+#include <iomanip> // column layout of the sweep summary
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable> // the event log writer sleeps on an empty ring instead of spinning
+#include <map>
+#include <set>
+#include <deque>
+#include <cstdio> // the event log writer does its own large fwrites to stdout
+#include <random> // mt19937 for --generate
+#include <csignal> // SIGUSR1 asks for a --checkpoint
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // __rdtsc for --profile
+#define HAVE_RDTSC
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h> // --memory-diff compares 8 words a step
+#endif
+
+#if defined(_WIN32)
+#define NO_MMAP // no POSIX mmap, --input reads the whole file into a buffer instead
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/resource.h> // getrusage for the --bench peak RSS
+#endif
 
 // ** Global variables **
-int CPU_clock = 0; // global variable to keep track of CPU clock cycles
-int context_switch_time = 2; // these need to be picked out of the file 
-int CPU_allocated_time = 5; // "                                      "
+// CPU_clock, context_switch_time and CPU_allocated_time used to live here. They belong to one run of the machine, so
+// they are now members of Simulation (below) and a sweep can run many simulations side by side.
 
 /*
 * Project 2 is asking us to take the code from project 1 and modify it so that round robin scheduling is used 
@@ -56,6 +88,19 @@ int CPU_allocated_time = 5; // "                                      "
 */
 
 
+/*
+* One decoded instruction. The parser fills these in once, data_offset included, after that the loader and the interpreter
+* just read them: no re-walking the data segment and no vector per instruction.
+* 16 bytes, so four instructions share a cache line.
+*/
+struct Instruction
+{
+    int op_code;        // 1: compute, 2: print, 3: store, 4: load
+    int operand_1;      // compute: iterations, print: cycles, store: value, load: address
+    int operand_2;      // compute: cycles, store: address, 0 for the one operand instructions
+    int data_offset;    // where this instruction's operands sit in the process data segment
+};
+
 struct PCB
 {
     int process_id;                             // ID of process
@@ -69,411 +114,5660 @@ struct PCB
     int max_memory_needed;                      // max logical memory required by process as defined in input file
     int main_memory_base;                       // starting address in main memory where process, PCB+logical_memory is loaded.  
 
-    std::vector<std::vector<int>> instructions; // each vector is a instruction, each element in the vector is data associated with instruction, 1st element being the opcode
+    int first_instruction;                      // index of this process's first instruction in Workload::instructionStream, with --stream its JobStream::jobs entry
+    int num_instructions;                       // number of instructions the process has in Workload::instructionStream
+    int arrival_time;                           // CPU_clock it arrives at, 0 unless the input is read with --stream
 };
 
-// ** FUNCTION PROTOTYPES ORDERED BY APPEARANCE BY CALL ** //
-void show_PCB(PCB process);
+// process states as they are stored in mainMemory[base + 1]
+const int STATE_NEW = 0;
+const int STATE_READY = 1;
+const int STATE_RUNNING = 2;
+const int STATE_IO_WAITING = 3;
+const int STATE_TERMINATED = 4;
 
-void loadJobsToMemory(std::queue<PCB> &newJobQueue, std::queue<int> &readyQueue, std::vector<int> &mainMemory, int maxMemory);
+/*
+* A job sitting in the IOWaitingQueue. We know the exact clock tick its print finishes at the moment it is parked,
+* so the queue is a min-heap on that tick: the next job to wake is always on top and an interrupt only has to look
+* at the top instead of walking every waiting job.
+*/
+struct IOWaitEntry
+{
+    int completion_time;    // CPU_clock value at which the I/O is done
+    int sequence;           // tie breaker so jobs finishing on the same tick leave in the order they came in
+    int slot;               // the waiting process, index into Simulation::processes and pcbTable
+    int entered_time;       // CPU_clock when the process was moved into the IOWaitingQueue
+};
 
-void executeCPU(int startAddress, std::vector<int> &mainMemory);
+struct IOWaitLater
+{
+    bool operator()(const IOWaitEntry &a, const IOWaitEntry &b) const
+    {
+        if (a.completion_time != b.completion_time)
+        {
+            return a.completion_time > b.completion_time;
+        }
+        return a.sequence > b.sequence;
+    }
+};
 
-void show_main_memory(std::vector<int> &mainMemory, int rows);
+typedef std::priority_queue<IOWaitEntry, std::vector<IOWaitEntry>, IOWaitLater> IOWaitQueue;
 
-int main(int argc, char** argv) 
+// the PCB fields the interpreter works on while a process holds the CPU, executeCPU loads and stores them
+struct CPUState
 {
-    // Step 1: Read and parse input file
-    // TODO: Implement input parsing and populate newJobQueue
+    int process_id;
+    int program_counter;
+    int CPU_cycles_used;
+    int register_value;
+    int instruction_base;
+    int max_memory_needed;
+    int num_instructions;
+    int slice_used;         // ticks used since this dispatch
+    int IO_cycles;          // cycles of the print that ended the slice, when it ended on EXIT_IO
+    int time_slice;         // ticks the scheduler gave this dispatch
+    int clock;              // CPU_clock of the core running it, the interpreter cores tick this and not the simulation's
+    long long instructions; // executed this slice
+    const Instruction *code;
+    int compute_left;       // cycles of a split compute still to go, see computeCycles
+    int page_table_base;    // --paging only
+};
 
-    // declare the variables to store the first two entires in a file
-    int max_memory;
-    int num_processes;
+// why an interpreter core handed the CPU back
+const int EXIT_TERMINATED = 0;
+const int EXIT_TIMEOUT = 1;
+const int EXIT_IO = 2;
 
-    // declare the data structures to store the processes and main memory
-    std::vector<int> mainMemory;
-    std::queue<int> readyQueue;
-    std::queue<PCB> newJobQueue;
-
-    // read in data from file
-    std::cin >> max_memory;
-    std::cin >> context_switch_time;
-    std::cin >> CPU_allocated_time;
-    std::cin >> num_processes;
-
-    std::cout << "max memory: " << max_memory << std::endl;
-    std::cout << "context switch time: " << context_switch_time << std::endl;
-    std::cout << "CPU allocated time: " << CPU_allocated_time << std::endl;
-    std::cout << "num processes: " << num_processes << std::endl;
-    
+// which interpreter core executeCPU uses, picked with --dispatch
+const int DISPATCH_BRANCH = 0;
+const int DISPATCH_THREADED = 1;
 
-    /* mainMemory.resize(max_memory, -1); // initialize main memory with -1 with size of maxMemory
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // this ignores any extra characters in the buffer namely the new line character, which would be picked up by the getline function in line 65
+/*
+* Ready queue disciplines, picked with --scheduler. The burst estimate all the non FIFO ones use is the job's remaining
+* CPU ticks read off its decoded instructions (compute cycles, 1 per store and load, prints are I/O and cost nothing).
+*/
+const int POLICY_RR = 0;         // FIFO ready queue, CPU_allocated_time slices: the classic
+const int POLICY_FCFS = 1;       // FIFO, no timeouts, a process keeps the CPU until it does I/O or terminates
+const int POLICY_SRTF = 2;       // least remaining work first, re-decided at every slice end and I/O return
+const int POLICY_PRIORITY = 3;   // static buckets by estimated slices needed, round robin within a bucket
+const int POLICY_MLFQ = 4;       // starts at its estimate's bucket, a timeout demotes, waiting too long promotes
 
-    /*
-    * This loop will fun for the number of process in the file (we know this value as it's the 2nd number in the file) and we will use a string to grab the line
-    * we then create a string stream from it which allows for us to extract data from the file. This wasn't needed for the sample files but in the larger files when the text
-    * wraps we pick up the new line character and it causes issues. This allows us to ignore the new line character and just read in the data.
-    */
-    for (unsigned int i = 0; i < num_processes; i++) 
-    {
-        std::string line;
-        std::getline(std::cin, line);  // grab the entire line
+const char *const scheduler_names[] = { "rr", "fcfs", "srtf", "priority", "mlfq" };
 
-        std::istringstream ss(line);  // create a string stream to parse the line
+// --paging fifo|clock|lfu: page replacement policy for the paged memory mode, see PagedMemory
+const int PAGE_FIFO = 0;        // evict the page that was brought in first
+const int PAGE_CLOCK = 1;       // second chance: the hand skips, and clears, frames referenced since it last passed
+const int PAGE_LFU = 2;         // evict the page with the fewest accesses since it was brought in
 
-        int process_id, max_memory_needed, number_of_instructions;  
-        ss >> process_id >> max_memory_needed >> number_of_instructions;   // read in first 3 variables of process
+const char *const page_policy_names[] = { "fifo", "clock", "lfu" };
 
-        PCB process;
-        process.process_id = process_id;
-        process.max_memory_needed = max_memory_needed;
-        process.state = 0; 
-        process.program_counter = 0;
-        process.memory_limit = process.max_memory_needed;
-        process.CPU_cycles_used = 0;
-        process.register_value = 0;
-    
+/*
+* How one run is set up beyond what its job file says. main fills one in from the command line, initSimulation copies
+* it into the Simulation and everything under runSimulation reads it from there, so two simulations in one process can
+* run with different settings. A --restore takes the fields its checkpoint records from the file instead.
+*/
+struct RunConfig
+{
+    int dispatch;               // --dispatch: which interpreter core executeCPU uses
+    int policy;                 // --scheduler
+    int levels;                 // --levels: buckets for priority, queues for mlfq, at most 32
+    int aging;                  // --aging: readyQueue wait that earns an mlfq promotion, 0 means 10 slices
 
-        // iterate the instructions of each process
-        for (unsigned int j = 0; j < number_of_instructions; j++) 
-        {
-            int instruction_opcode;  // read in opcode based on that read in data of instruction
-            ss >> instruction_opcode;
+    int cpus;                   // --cpus: 0 is the classic single CPU loop, n runs the SMP loop with n cores (1 included, it matches the classic run)
+    int migration_cost;         // --migration-cost: extra ticks on top of context_switch_time when a process changes core
+    unsigned int host_threads;  // --host-threads: run independent cores' slices on this many host threads, 0 or 1 for none
 
-            std::vector<int> current_instruction;  // instruction-arr for cur-instruction
-            current_instruction.push_back(instruction_opcode); // add opcode as first element for this instruction-arr
+    bool mirror_pcb;            // --mirror-pcb: keep the PCB header words in mainMemory up to date while running
+    bool split_compute;         // --split-compute: a compute longer than what is left of the slice is cut at the slice end
 
-            if (instruction_opcode == 1) // 1: compute
-            {
-                int iterations, cycles;
-                ss >> iterations >> cycles;
-                current_instruction.push_back(iterations);
-                current_instruction.push_back(cycles);
+    bool paging;                // --paging fifo|clock|lfu: the paged memory mode with this page_policy, see PagedMemory
+    int page_policy;
+    int frame_size;             // --frame-size: words per page and per frame, a power of two
+    int tlb_entries;            // --tlb: direct mapped TLB entries, a power of two
+    int page_fault_cost;        // --page-fault-cost: ticks a fault charges the faulting process, on top of the access
+};
 
-                //std::cout << "instruction: " << instruction_opcode << " iter: " << iterations << " cycles: " << cycles << std::endl;
-            } 
-            if (instruction_opcode == 2) // 2:  print 
-            { 
-                int cycles;
-                ss >> cycles;
-                current_instruction.push_back(cycles);
+/*
+* --profile <file>: where host time goes, as a flat profile on stderr and folded stacks ("a;b;c ticks" per line, what
+* flamegraph.pl and speedscope read) in <file>. The single CPU loop and everything under it are templates on a
+* Profiled flag and runSimulation picks the instantiation once, by whether the Simulation has a Profile to count into, so
+* without --profile none of the counting is compiled into the loop that runs. Ticks are rdtsc where there is one, steady_clock otherwise, converted to seconds against
+* steady_clock over the whole run.
+*/
+const int PROFILE_PARSE = 0;    // main's phases, in the order they run
+const int PROFILE_LOAD = 1;
+const int PROFILE_DUMP = 2;
+const int PROFILE_RUN = 3;
+const int PROFILE_REPORT = 4;
+const int PROFILE_PHASES = 5;
 
-                //std::cout << "instruction: " << instruction_opcode << " cycles: " << cycles << std::endl;
-            } 
-            if (instruction_opcode == 3) // 3:  store
-            {   
-                int value, address;
-                ss >> value >> address;
-                current_instruction.push_back(value);  
-                current_instruction.push_back(address);
+const char *const profile_phase_names[] = { "parse", "load", "dump", "run", "report" };
 
-                //std::cout << "instruction: " << instruction_opcode << " value: " << value << " address: " << address << std::endl;
-            }
-            if (instruction_opcode == 4) // 4:  load
-            {
-                int address;
-                ss >> address;
-                current_instruction.push_back(address);
+struct Profile
+{
+    std::chrono::steady_clock::time_point start_time;
+    unsigned long long start_ticks;
+    unsigned long long mark;                        // end of the last phase
+    unsigned long long phase_ticks[PROFILE_PHASES];
 
-                //std::cout << "instruction: " << instruction_opcode << " address: " << address << std::endl;
-            }
+    // inside the run: what the single CPU loop spends its time on
+    unsigned long long select_ticks;                // popReady, the scheduler's pick
+    unsigned long long idle_io_ticks;               // I/O wakeups while nothing was ready
+    unsigned long long slice_ticks;                 // executeCPU as a whole, context switch in and out included
+    unsigned long long slice_io_ticks;              // I/O wakeups at slice ends, part of slice_ticks
+    unsigned long long interpret_ticks;             // runSlice, part of slice_ticks
+    unsigned long long io_ticks;                    // every checkIOWaitingQueue
+    long long selects;
+    long long slices;
+    long long op_counts[5];                         // executed instructions by opcode, 0 for invalid ones
 
-            process.instructions.push_back(current_instruction);
-        }
+    std::vector<unsigned long long> process_ticks;  // runSlice ticks by process slot
+};
 
-        // push the PCB to new-job-queue
-        newJobQueue.push(process);  
-    }
-    std::cout << std::endl;
+std::string checkpoint_path;    // --checkpoint <file>: where snapshots of the running simulation go
+int checkpoint_every = 0;       // --checkpoint-every: CPU_clock ticks between snapshots, 0 for only on SIGUSR1
+volatile std::sig_atomic_t checkpoint_requested = 0; // set by the SIGUSR1 handler, the next dispatch writes a snapshot
 
+#if defined(__GNUC__) || defined(__clang__)
+#define USE_COMPUTED_GOTO // labels as values, lets runThreaded jump straight from handler to handler
+#endif
 
-    
-    // Step 2: Load jobs into main memory
-    loadJobsToMemory(newJobQueue, readyQueue, mainMemory, max_memory);
+// a read only view of a whole input file, mmap'd where we can and read into a buffer where we can't
+struct MappedFile
+{
+    const char *data;
+    size_t size;
+    std::vector<char> buffer; // only used under NO_MMAP
+};
 
-    // print main memory
-    for (int i = 0; i < mainMemory.size(); i++)
-    {
-        std::cout << i << " : " << mainMemory[i] << "\n";
-    }
+/*
+* Binary workload file (--convert writes it, --binary runs it). All fields are native 32 bit ints:
+*   WorkloadHeader
+*   num_processes  x WorkloadProcess   loaded ones in readyQueue order, then the ones still in the newJobQueue
+*   num_instructions x Instruction     the decoded instructionStream, data offsets filled in
+*   image_words    x int               mainMemory[0, image_words) exactly as loadJobsToMemory left it
+* Loading it is two bulk copies, no parsing and no loadJobsToMemory for the jobs that were already in memory.
+* Version 2 added the newJobQueue entries, so overcommitted workloads keep the jobs that did not fit yet.
+*/
+const int WORKLOAD_MAGIC = 0x4C575343; // "CSWL" when read back on a little endian machine
+const int WORKLOAD_VERSION = 2;
 
+struct WorkloadHeader
+{
+    int magic;
+    int version;
+    int max_memory;
+    int context_switch_time;
+    int CPU_allocated_time;
+    int num_processes;
+    int num_instructions;
+    int image_words;
+};
 
-    // // Step 4: Process execution
-    while (!readyQueue.empty())
-    {
-        int PCB_start_address = readyQueue.front();
-        readyQueue.pop();
-        executeCPU(PCB_start_address, mainMemory);
-    }
- 
+struct WorkloadProcess
+{
+    int main_memory_base;   // where the PCB sits in the image, -1 for a job still waiting in the newJobQueue
+    int first_instruction;  // where its instructions start in the instruction section
+    int process_id;
+    int max_memory_needed;
+    int num_instructions;
+};
 
-    return 0;
-} // END OF MAIN
+/*
+* Allocator for the simulated main memory. Free blocks live in two ordered sets: by address, so a freed block finds and
+* merges with its neighbours in O(log n), and by (size, address), so best fit is a single lower_bound. A job needs one
+* block of 10 PCB words plus its max_memory_needed.
+*/
+struct MemoryAllocator
+{
+    std::map<int, int> free_by_address;             // start address -> size
+    std::set<std::pair<int, int>> free_by_size;     // (size, start address), smallest fitting block first
 
+    int capacity;               // max_memory
+    int words_in_use;
+    int peak_words_in_use;
 
-void show_PCB(PCB process) 
+    int allocations;
+    int frees;
+    int failed_admissions;      // times the job at the front of the newJobQueue did not fit
+    double fragmentation_sum;   // external fragmentation sampled at every failed admission
+    double worst_fragmentation;
+};
+
+/*
+* Paged memory mode (--paging). Every job is admitted up front into a backing store laid out exactly like mainMemory
+* would be in the contiguous mode, and mainMemory becomes max_memory / frame_size frames that STORE and LOAD page the
+* job's logical memory in and out of on demand. All of it is sized once in initPagedMemory: one flat page table with a
+* run of entries per process, a direct mapped TLB tagged with those global page numbers (so nothing is flushed on a
+* context switch), and per frame bookkeeping for the replacement policies. A translation is a shift, a mask and at most
+* two array reads, and nothing is allocated while the simulation runs.
+*/
+struct TLBEntry
 {
-    std::cout << "PROCESS ["<<process.process_id<<"] " << "maxMemoryNeeded: " << process.max_memory_needed << std::endl;
-    std::cout << "num-instructions: " << process.instructions.size() << std::endl;
+    int page;   // global page number, index into PagedMemory::pageTable, -1 when empty
+    int frame;
+};
 
-    for (unsigned int i=0; i<process.instructions.size(); i++) 
-    {
-        std::vector<int> current_instruction = process.instructions[i];
+struct PageFrame
+{
+    int page;               // global page number held here, -1 when the frame is free
+    int backing_address;    // where that page lives in the backing store
+    int words;              // frame_size, less for the last page of a job
+    bool dirty;             // stored to since it was paged in, written back when it is evicted
+    bool referenced;        // clock: accessed since the hand last went by
+    int uses;               // lfu: accesses since it was paged in
+    int older;              // fifo: neighbours in load order, -1 at either end
+    int newer;
+};
 
-        if (current_instruction[0] == 1) // compute: 2 parameters
-        { 
-            std::cout << "instruction: " << current_instruction[0] << " iter: " << current_instruction[1] << " cycles: " << current_instruction[2] << std::endl;
-        }
-        if (current_instruction[0] == 2) // print: 2 parameters
-        {
-            std::cout << "instruction: " << current_instruction[0] << " cycles: " << current_instruction[1] << std::endl;
-        }
-        if (current_instruction[0] == 3) // write: 2 parameters 
-        {
-            std::cout << "instruction: " << current_instruction[0] << " value: " << current_instruction[1] << " address: " << current_instruction[2] << std::endl;
-        }
-        if (current_instruction[0] == 4) // load: 2 parameters
-        {
-            std::cout << "instruction: " << current_instruction[0] << " address: " << current_instruction[1] << std::endl;
-        }
-        
-    }// END FOR LOOP
-} //  END show_PCB
+struct PagedMemory
+{
+    int frame_shift;                    // log2 of frame_size
+    int frame_mask;                     // frame_size - 1
+    int frames;
+    int tlb_mask;                       // tlb_entries - 1
+
+    std::vector<int> backingStore;      // every job's PCB header and logical memory, contiguous mode layout
+    std::vector<int> pageTable;         // global page number -> frame, -1 while not resident
+    std::vector<TLBEntry> tlb;
+    std::vector<PageFrame> frame;
+    std::vector<int> freeFrames;        // stack of free frames, only shrinks until processes start terminating
+    int oldest;                         // fifo: head and tail of the resident frames in load order
+    int newest;
+    int hand;                           // clock and lfu: where the next victim search starts
 
+    int backing_used;                   // words of backingStore handed out at admission
+    int pages_used;                     // pageTable entries handed out at admission
+
+    long long tlb_hits;
+    long long tlb_misses;
+    long long faults;
+    long long fault_ticks;              // clock charged for them
+    long long evictions;
+    long long write_backs;              // evictions of a dirty page
+};
 
-void loadJobsToMemory(std::queue<PCB>& newJobQueue, std::queue<int>& readyQueue, std::vector<int>& mainMemory, int maxMemory) 
+/*
+* Everything read out of the input: the header values and every job, decoded. It is filled in once and only read after
+* that, so all the simulations of a sweep share a single copy.
+*/
+struct Workload
 {
+    int max_memory;
+    int context_switch_time;
+    int CPU_allocated_time;
+    int num_processes;
 
-    int current_address = 0;
+    std::vector<PCB> jobs;                          // in input order, each simulation's newJobQueue starts as these
+    std::vector<Instruction> instructionStream;     // every job's decoded instructions back to back, PCB::first_instruction indexes it
 
-    while (!newJobQueue.empty()) 
-    {
-        PCB current_process = newJobQueue.front();  // access front element
-        newJobQueue.pop();  
+    std::vector<int> memory_image;                  // --binary only: mainMemory prefix exactly as loadJobsToMemory left it
+    std::vector<WorkloadProcess> image_processes;   // --binary only: loaded PCBs in readyQueue order, then the unloaded jobs
 
-        current_process.main_memory_base = current_address;
-        current_process.instruction_base = current_address + 10; 
-        current_process.data_base = current_process.instruction_base + current_process.instructions.size();
+    std::vector<int> remainingBurst;                // per instruction: CPU ticks from it to the end of its job, the schedulers' burst estimate
+};
 
-        mainMemory[current_address] = current_process.process_id;
-        mainMemory[current_address + 1] = 1;
-        mainMemory[current_address + 2] = current_process.program_counter;
-        mainMemory[current_address + 3] = current_process.instruction_base;
-        mainMemory[current_address + 4] = current_process.data_base;
-        mainMemory[current_address + 5] = current_process.memory_limit;
-        mainMemory[current_address + 6] = current_process.CPU_cycles_used;
-        mainMemory[current_address + 7] = current_process.register_value;
-        mainMemory[current_address + 8] = current_process.max_memory_needed;
-        mainMemory[current_address + 9] = current_process.main_memory_base;
+/*
+* The hot half of a loaded process: everything a dispatch reads and a context switch saves, the scheduler's own fields
+* included, in exactly one 64 byte cache line. Simulation::pcbTable keeps these back to back, so a queue of process
+* slots walks a dense, aligned array instead of the PCB headers spread through mainMemory. The header words in
+* mainMemory are written at admission for the memory dump and kept in step afterwards only with --mirror-pcb.
+*/
+struct alignas(64) HotPCB
+{
+    int process_id;
+    int state;
+    int program_counter;
+    int CPU_cycles_used;
+    int register_value;
+    int instruction_base;
+    int num_instructions;
+    int max_memory_needed;
+    int compute_left;       // --split-compute: cycles still owed by the compute at program_counter, 0 when it has not started
+    int first_instruction;  // into the workload's instructionStream
+    int ready_since;        // CPU_clock when it last entered the readyQueue
+    int waiting_time;       // ticks spent sitting in the readyQueue so far
+    int first_run_time;     // CPU_clock when it first moved to Running, -1 until then, also its response time
+    int context_switches;   // dispatches onto the CPU
+    int level;              // priority bucket or MLFQ level, 0 runs first, -1 until it is first queued
+    int core;               // SMP: the core whose run queue it goes back to, -1 until it is first queued
+};
+static_assert(sizeof(HotPCB) == 64, "a HotPCB is meant to be exactly one cache line");
 
-        int num_instructions = current_process.instructions.size();
+// the cold half: written a few times in a process's life and read by the reports at the end
+struct ProcessRecord
+{
+    int arrival_time;       // CPU_clock it arrived at, its queue latencies are counted from here
+    int main_memory_base;   // with --paging this is where the PCB sits in the backing store
+    int page_table_base;    // --paging: its first entry in PagedMemory::pageTable, -1 otherwise
+    int data_base;
+    int memory_limit;
+    int admitted_time;      // CPU_clock when it got a block of main memory
+    int completion_time;    // CPU_clock when it terminated, -1 until then
+    int IO_wait_time;       // ticks spent in the IOWaitingQueue so far
+    int timeouts;           // TimeOUT interrupts
+    int IO_waits;           // IOInterrupts
+};
 
-        int instruction_address = current_process.instruction_base;
-        int data_address = current_process.data_base;
+/*
+* Log-linear latency histogram in the HDR style: values under 32 get a bucket each, above that every power of two is
+* split into 16 equal buckets, so any recorded value is off by at most 1/16 and recording is a bit scan, a shift and an
+* increment. Covers every non negative int.
+*/
+const int HISTOGRAM_LINEAR = 32;        // values 0..31 are exact
+const int HISTOGRAM_SUB_BUCKETS = 16;   // buckets per power of two above that
+const int HISTOGRAM_BUCKETS = HISTOGRAM_LINEAR + (31 - 5) * HISTOGRAM_SUB_BUCKETS;
 
-        for (unsigned int i = 0; i < num_instructions; i++) 
-        {
-            std::vector<int> current_instruction = current_process.instructions[i];
-            int op_code = current_instruction[0];
-           
-            mainMemory[instruction_address++] = op_code; 
+const int METRICS_CSV = 0;
+const int METRICS_JSON = 1;
 
-            if (op_code == 1) // compute
-            {  
-                mainMemory[data_address++] = current_instruction[1];
-                mainMemory[data_address++] = current_instruction[2];
-            }
-            else if (op_code == 2) // print
-            { 
-                mainMemory[data_address++] = current_instruction[1];
-            }
-            else if (op_code == 3) // store
-            { 
-                mainMemory[data_address++] = current_instruction[1];
-                mainMemory[data_address++] = current_instruction[2];
-            }
-            else if (op_code == 4) // load
-            {  
-                mainMemory[data_address++] = current_instruction[1];
-            }
-        }
+// --memory-dump: how main memory is printed once the jobs are loaded
+const int DUMP_FULL = 0;        // one "address : value" line per word, the classic output
+const int DUMP_RLE = 1;         // runs of one value, the -1 fill above all, as a single "first-last : value" line
+const int DUMP_NONE = 2;
+const int DUMP_MIN_RUN = 4;     // shorter runs than this are printed word by word
 
-        current_address = current_process.instruction_base + current_process.max_memory_needed;  // change to the next process
-        readyQueue.push(current_process.main_memory_base);  // push the base-address of process
+struct LatencyHistogram
+{
+    long long counts[HISTOGRAM_BUCKETS];
+    long long count;
+    long long sum;
+    int max;
+};
 
-    } // END WHILE
-} // END FUNCTION
+// one histogram per queue a process can wait in, plus the per process totals the scheduler gets judged on
+struct QueueMetrics
+{
+    LatencyHistogram new_job_wait;  // newJobQueue: admission latency
+    LatencyHistogram ready_wait;    // readyQueue: every visit, not the per process total
+    LatencyHistogram IO_wait;       // IOWaitingQueue: every visit
+    LatencyHistogram response;      // arrival to first run
+    LatencyHistogram turnaround;    // arrival to termination
+};
+
+/*
+* Event log. The simulator never formats anything itself: each queue transition or executed instruction is one 20 byte
+* EventRecord appended to a preallocated ring, and a background writer thread turns batches of them into text or JSON
+* lines and writes those out in large chunks. One simulator thread writes the ring and one writer thread reads it, so
+* head and tail are the only shared state. A full ring makes the simulator wait rather than lose events. Neither side
+* spins: the writer sleeps while the ring is empty and the simulator wakes it every EVENT_WAKE_BATCH events and when it is
+* done, the simulator sleeps while the ring is full and the writer wakes it after each batch it drains. Every sleep is
+* also bounded by EVENT_WAIT, so a wake-up that slips past a waiter only costs that long.
+*/
+const int LOG_OFF = 0;              // no events while running, the result is printed once at the end by show_run_summary
+const int LOG_TRANSITIONS = 1;      // queue transitions only
+const int LOG_INSTRUCTIONS = 2;     // transitions plus one line per executed instruction, the classic output
+
+const int LOG_FORMAT_TEXT = 0;
+const int LOG_FORMAT_JSON = 1;
 
-void executeCPU(int startAddress, std::vector<int>&  mainMemory) 
+// what happened, EventRecord::type
+const int EVENT_RUNNING = 0;        // ReadyQueue to Running
+const int EVENT_TIMEOUT = 1;        // Running to ReadyQueue
+const int EVENT_IO_WAIT = 2;        // Running to IOWaitingQueue
+const int EVENT_IO_DONE = 3;        // IOWaitingQueue to ReadyQueue
+const int EVENT_ADMITTED = 4;       // newJobQueue to main memory, value is the base address, waited the ticks it spent queued
+const int EVENT_COMPUTE = 5;        // the rest are executed instructions, value is the opcode
+const int EVENT_PRINT = 6;
+const int EVENT_STORED = 7;
+const int EVENT_STORE_ERROR = 8;
+const int EVENT_LOADED = 9;
+const int EVENT_LOAD_ERROR = 10;
+const int EVENT_TERMINATED = 11;    // Running to Terminated, value is when it first ran
+const int EVENT_FINISHED = 12;      // every job is done, clock is the total CPU time
+
+struct EventRecord
 {
-    
-    // pull metadata of PCB from main memory
-    int process_id = mainMemory[startAddress];
-    int state = mainMemory[startAddress + 1];
-    int program_counter = mainMemory[startAddress + 2];  // create temporary variables that do no modify memory just yet!!
-    int instruction_base = mainMemory[startAddress + 3];
-    int data_base = mainMemory[startAddress + 4];
-    int memory_limit = mainMemory[startAddress + 5];
-    int CPU_cycles_used = mainMemory[startAddress + 6];
-    int register_value = mainMemory[startAddress + 7];
-    int max_memory_needed = mainMemory[startAddress + 8];
-    int main_memory_base = mainMemory[startAddress + 9];
-
-    // number of instructions or opcodes is distance between database and isntruction_base
-    int num_instructions = data_base - instruction_base; 
-    int data_size = memory_limit - num_instructions; // size of data-segment
-
-
-    // index in the data segment of instructions
-    int memory_index = 0; 
+    int clock;
+    int process_id;
+    int type;
+    int value;
+    int waited;     // EVENT_ADMITTED only: clock minus its arrival time, not the clock itself once jobs arrive with --stream
+};
+static_assert(sizeof(EventRecord) == 20, "an EventRecord is the five ints the simulator copies per event, nothing more");
 
-    // iterate number of instructions or opcodes
-    for (unsigned int i=0; program_counter < num_instructions; i++) 
-    {
-        int current_op_code = mainMemory[instruction_base + i]; // get current opcode in memory, using address of thwere instructions start plus ith instruction
-        std::vector<int> current_instruction_data;  // each element is the parameters for the current instruction/opcode
+const size_t EVENT_RING_SIZE = 1 << 16; // records, a power of two so the slot is head & (size - 1)
+const size_t EVENT_WAKE_BATCH = 1 << 12; // events between the simulator's wake-ups of the writer, a power of two below the ring size
+const std::chrono::milliseconds EVENT_WAIT(1); // longest either side sleeps before looking at the ring again
 
-        // compute: has 2 parameters
-        if (current_op_code == 1) 
-        {
-            if (memory_index + 1 >= data_size) // if not enough parameters to do a compute operation push -1 not possible
-            {  
-                current_instruction_data.push_back(-1);
-                current_instruction_data.push_back(-1);
-            } 
-            else 
-            {
-                current_instruction_data.push_back(mainMemory[data_base + memory_index]);  // iterations
-                current_instruction_data.push_back(mainMemory[data_base + memory_index + 1]);  // cycles
-            }
-            memory_index += 2;
-        }
+struct EventLog
+{
+    int level;
+    int format;
+    FILE *out;
 
-        // store: has 2 parameters
-        else if (current_op_code == 3) 
-        {
-            if (memory_index + 1 >= data_size) 
-            {
-                current_instruction_data.push_back(-1);
-                current_instruction_data.push_back(-1);
-            } 
-            else 
-            {
-                current_instruction_data.push_back(mainMemory[data_base + memory_index]);   // value
-                current_instruction_data.push_back(mainMemory[data_base + memory_index + 1]);  // address
-            }
-            memory_index += 2;
-        }
+    std::vector<EventRecord> ring;
+    std::atomic<size_t> head;   // next slot the simulator fills, only the simulator moves it
+    std::atomic<size_t> tail;   // next slot the writer formats, only the writer moves it
+    std::atomic<bool> done;     // set once the simulator has appended its last event
+    std::thread writer;
 
-        // load: has 1 parameter
-        else if (current_op_code == 4) 
-        {
-            if (memory_index >= data_size) 
-            {
-                current_instruction_data.push_back(-1);
-            } 
-            else 
-            {
-                current_instruction_data.push_back(mainMemory[data_base + memory_index]);  // address
-            }
-            memory_index += 1;
-        }
+    std::mutex wait_lock;               // only taken to sleep or to wake the other side, never per event
+    std::condition_variable has_events; // the writer sleeps on it while the ring is empty
+    std::condition_variable has_room;   // the simulator sleeps on it while the ring is full
+};
+
+// --scheduler srtf: least remaining work on top, ties in the order they were queued
+struct SRTFEntry
+{
+    int remaining;
+    int sequence;
+    int slot;
+};
 
-        // print: has 1 parameter
-        else if (current_op_code == 2) 
+struct SRTFLater
+{
+    bool operator()(const SRTFEntry &a, const SRTFEntry &b) const
+    {
+        if (a.remaining != b.remaining)
         {
-            if (memory_index >= data_size) 
-            {
-                current_instruction_data.push_back(-1);
-            } 
-            else 
-            {
-                current_instruction_data.push_back(mainMemory[data_base + memory_index]);
-            }
-            memory_index += 1;
+            return a.remaining > b.remaining;
         }
+        return a.sequence > b.sequence;
+    }
+};
 
+/*
+* The ready set, as process slots, kept in whatever shape the policy picks from cheaply: one FIFO for rr and fcfs, a binary heap for srtf,
+* bucketed FIFOs for priority and mlfq with a bitmask of the non empty ones so the next pick is a single bit scan.
+*/
+// priority and mlfq bucket entry: since is the CPU_clock it joined this bucket, what mlfq aging is measured from
+struct LevelEntry
+{
+    int slot;
+    int since;
+};
 
-        // process each instruction opcode and update the parameters
+struct Scheduler
+{
+    int policy;
+    int levels;
+    int aging;
+    size_t count;                       // processes ready, across whichever structure the policy uses
 
-        if (current_op_code == 1) // COMPUTE
-        {
-            CPU_cycles_used += current_instruction_data[1];
-            std::cout << "compute" << "\n";
-        }
-        else if (current_op_code == 2) // PRINT
-        {
-            CPU_cycles_used += current_instruction_data[0];
-            std::cout << "print" << "\n";
-        }
-        else if (current_op_code == 3) // STORE
-        {
-            // check if we are inside data segment
-            if (current_instruction_data[1] + instruction_base >= instruction_base && (current_instruction_data[1] + instruction_base) < max_memory_needed + instruction_base) 
-            { 
-                mainMemory[current_instruction_data[1] + instruction_base] = current_instruction_data[0];
-                register_value = current_instruction_data[0];
-                std::cout << "stored" << "\n";
-            } 
-            else 
-            {
-                register_value = current_instruction_data[0];
-                std::cout << "store error!" << "\n";
-            }
-            CPU_cycles_used++;
-        }
-        // LOAD
-        else if (current_op_code == 4) 
-        {
-            // check if we are inside data segment
-            if ((current_instruction_data[0] + instruction_base) >= instruction_base && (current_instruction_data[0] + instruction_base) < (max_memory_needed + instruction_base)) 
-            {
-                register_value = mainMemory[current_instruction_data[0] + instruction_base];
-                std::cout << "loaded" << "\n";
-            } 
-            else
-            {
-                std::cout << "load error!" << "\n";
-            }
-            CPU_cycles_used++;
-        }
-        // invalid opcode
-        else 
-        {
-            std::cerr << "ERROR: Invalid opcode " << current_op_code << "\n";
-        }
+    std::queue<int> fifo;
+    std::priority_queue<SRTFEntry, std::vector<SRTFEntry>, SRTFLater> shortest;
+    std::vector<std::queue<LevelEntry>> buckets; // each in order of since, a promotion joins its new bucket at the back as the newest
+    unsigned int occupied;              // bit i set while buckets[i] is non empty
+    int sequence;
+};
 
-        program_counter++; // increment program counter
-    } // END I FOR LOOP
+/*
+* One logical CPU of the SMP mode. Each core has its own clock and its own run queue, the owner takes from the front of
+* it and an idle core steals from the back of the longest one. running is the process whose slice has been executed
+* but not yet committed: that happens when the core's clock comes up again (see runSMP).
+*/
+struct Core
+{
+    int clock;
+    std::deque<int> runQueue;   // process slots
+    int running;                // process slot, -1 when idle
+    CPUState cpu;
+    int exit_reason;
 
-    mainMemory[startAddress + 1] = 4;                    // terminate process
-    mainMemory[startAddress + 2] = instruction_base - 1; // update program counter for this PCB, to be before instructionBase
-    mainMemory[startAddress + 6] = CPU_cycles_used;
-    mainMemory[startAddress + 7] = register_value;
+    long long busy_ticks;       // executing instructions
+    long long switch_ticks;     // context switches plus migrations
+    long long idle_ticks;
+    long long dispatches;
+    long long steals;           // processes this core took from another core's queue
+    long long migrations;       // dispatches of a process that last ran or was queued elsewhere
+};
 
-    // Print PCB information.
-    /*
-    std::cout << "Process ID: " << process_id << "\n";
-    std::cout << "State: TERMINATED\n";
-    std::cout << "Program Counter: " << mainMemory[startAddress + 2] << "\n";
-    std::cout << "Instruction Base: " << instruction_base << "\n";
-    std::cout << "Data Base: " << data_base << "\n";
-    std::cout << "Memory Limit: " << memory_limit << "\n";
-    std::cout << "CPU Cycles Used: " << CPU_cycles_used << "\n";
-    std::cout << "Register Value: " << register_value << "\n";
-    std::cout << "Max Memory Needed: " << max_memory_needed << "\n";
-    std::cout << "Main Memory Base: " << main_memory_base << "\n";
-    std::cout << "Total CPU Cycles Consumed: " << CPU_cycles_used << "\n";
-    */
-} // END FUNCTION
+/*
+* --stream: jobs are read one at a time as the clock reaches their arrival times instead of all up front. A job's
+* decoded instructions live in a StreamedJob of their own from when it is read until it terminates, and terminated
+* processes' slots are reused, so memory follows the number of live jobs instead of the length of the input. The input
+* is the usual format with an arrival tick in front of every job, in non decreasing order, read through a refilling
+* buffer so a pipe works as well as a file. A num_processes of 0 in the header reads until the input ends.
+*/
+struct StreamedJob
+{
+    std::vector<Instruction> code;
+    std::vector<int> remainingBurst;
+};
 
-void show_main_memory(std::vector<int> &mainMemory, int rows) 
+struct JobStream
 {
-    for (unsigned int i = 0; i < rows; i++)
-    {
-        std::cout << i << ": " << mainMemory[i] << std::endl;
-    }
+    FILE *in;                       // the --input file or stdin
+    std::vector<char> buffer;       // read buffer, refilled as the parser reaches its end
+    size_t position;                // next unread byte
+    size_t filled;                  // bytes of buffer holding input
+    bool input_ended;               // the last read came back empty
+
+    long long jobs_left;            // still to read according to the header, -1 to read until the input ends
+    int last_arrival;
+    bool has_next;                  // next has been read ahead and waits for the clock to reach its arrival time
+    PCB next;
+
+    std::vector<StreamedJob> jobs;  // every job read and not yet terminated, by PCB::first_instruction
+    std::vector<int> free_jobs;     // entries of jobs to reuse
+    std::vector<int> free_slots;    // pcbTable slots of terminated processes, the next admission takes one
+
+    long long jobs_read;
+    long long live_jobs;            // read and not yet terminated or rejected
+    long long peak_live_jobs;
+    long long finished_cycles;      // CPU_cycles_used of terminated processes, whose slots no longer have it
+};
+
+/*
+* One run of the machine: its clock, its scheduler parameters, its own mainMemory and queues. Nothing in here is shared,
+* so any number of simulations can run at once over one read only Workload.
+*/
+struct Simulation
+{
+    const Workload *workload;
+    JobStream *stream;                  // --stream only: where jobs come from as they arrive, nullptr otherwise
+    int next_checkpoint;                // CPU_clock the next --checkpoint is due at, -1 when not checkpointing
+
+    int CPU_clock;                      // keeps track of CPU clock cycles
+    int context_switch_time;
+    int CPU_allocated_time;
+    int log_level;                      // LOG_OFF, LOG_TRANSITIONS or LOG_INSTRUCTIONS, LOG_OFF for sweeps
+    EventLog *log;                      // where events go, nullptr when log_level is LOG_OFF
+    RunConfig config;                   // the run's options, see RunConfig
+    Profile *profile;                   // --profile only: what the Profiled loop counts into, nullptr otherwise
+
+    std::vector<int> mainMemory;
+    MemoryAllocator memory;             // which parts of mainMemory belong to a process
+    PagedMemory paged;                  // --paging only, mainMemory is page frames then and the allocator is unused
+    std::queue<PCB> newJobQueue;        // jobs waiting for a block of main memory
+    Scheduler readyQueue;               // the ready set, ordered by the --scheduler policy
+    std::vector<Core> cores;            // SMP mode only, the readyQueue is unused then
+    IOWaitQueue IOWaitingQueue;
+
+    std::vector<HotPCB> pcbTable;       // one per process ever admitted, indexed by process slot
+    std::vector<ProcessRecord> processes;   // cold half, same slots
+    QueueMetrics metrics;
+    std::vector<int> processSlotAt;     // process slot of the PCB that starts at a main memory address, -1 if none
+    int rejected_jobs;                  // jobs bigger than all of main memory, dropped instead of waiting forever
 
-    std::cout << std::endl;
-} // END FUNCTION
\ No newline at end of file
+    int IO_sequence;                    // running count of jobs sent to I/O, tie breaker for the IOWaitingQueue
+    long long instructions_executed;    // instructions run by either interpreter core, for --time
+};
+
+/*
+* Checkpoint file (--checkpoint writes it, --restore resumes from it): everything a single CPU simulation carries from
+* one dispatch to the next, the decoded workload included, so a restore neither parses nor loads anything. All native:
+*   CheckpointHeader
+*   instructions x Instruction, then instructions x int     instructionStream, remainingBurst
+*   max_memory x int                                        mainMemory
+*   processes x HotPCB, then processes x ProcessRecord      pcbTable, processes
+*   new_jobs x PCB                                          newJobQueue, front first
+*   ready x SRTFEntry                                       readyQueue in pop order, for priority and mlfq bucket by
+*                                                           bucket with the bucket in remaining
+*   IO_waiting x IOWaitEntry                                in pop order
+*   free_blocks x 2 int                                     the allocator's free (address, size) blocks
+*   QueueMetrics
+*   --paging only: backing_words x int, pages x int, tlb_entries x TLBEntry, frames x PageFrame, free_frames x int
+*/
+const int CHECKPOINT_MAGIC = 0x4B435343; // "CSCK" when read back on a little endian machine
+const int CHECKPOINT_VERSION = 3; // 2: PCB and ProcessRecord carry an arrival time, 3: bucket entries carry their mlfq aging time
+
+struct CheckpointHeader
+{
+    int magic;
+    int version;
+
+    // the run's parameters, a restore uses these whatever its own command line says
+    int max_memory;
+    int context_switch_time;
+    int CPU_allocated_time;
+    int num_processes;
+    int policy;
+    int levels;
+    int aging;
+    int split_compute;
+    int mirror_pcb;
+    int paging;
+    int page_policy;
+    int frame_size;
+    int tlb_entries;
+    int page_fault_cost;
+
+    // where the run was
+    int CPU_clock;
+    int rejected_jobs;
+    int IO_sequence;
+    int ready_sequence;
+    long long instructions_executed;
+
+    // allocator and pager scalars
+    int words_in_use;
+    int peak_words_in_use;
+    int allocations;
+    int frees;
+    int failed_admissions;
+    double fragmentation_sum;
+    double worst_fragmentation;
+    int oldest;
+    int newest;
+    int hand;
+    int backing_used;
+    int pages_used;
+    long long tlb_hits;
+    long long tlb_misses;
+    long long faults;
+    long long fault_ticks;
+    long long evictions;
+    long long write_backs;
+
+    // section lengths
+    int instructions;
+    int processes;
+    int new_jobs;
+    int ready;
+    int IO_waiting;
+    int free_blocks;
+    int backing_words;
+    int pages;
+    int frames;
+    int free_frames;
+};
+
+// one line of the --sweep summary
+struct SweepResult
+{
+    int context_switch_time;
+    int CPU_allocated_time;
+    int final_clock;
+    int processes_finished;
+    double average_turnaround;
+    double average_waiting;
+};
+
+/*
+* Knobs for --generate. Every range is inclusive, the mix is a relative weight per opcode 1-4 (compute, print, store,
+* load), so the print weight is the I/O density and io_cycles is how long each of those prints keeps the job waiting.
+*/
+struct GeneratorConfig
+{
+    int jobs;
+    unsigned int seed;
+    int min_instructions, max_instructions;     // per job
+    int mix[4];
+    int min_job_memory, max_job_memory;         // max_memory_needed, raised to fit the job's own code and data
+    int min_io_cycles, max_io_cycles;
+    int min_compute_cycles, max_compute_cycles;
+    int max_memory;                             // main memory in the header, 0 sizes it to hold every job at once
+    int context_switch_time;
+    int CPU_allocated_time;
+    bool arrivals;                              // --arrivals: put an arrival tick in front of every job, for --stream
+    int min_arrival_gap, max_arrival_gap;       // ticks from one job's arrival to the next
+};
+
+// best of --repeat runs for each phase of --bench
+struct BenchmarkResult
+{
+    double parse_seconds;
+    double load_seconds;
+    double execute_seconds;
+    long long instructions;
+    int processes_finished;
+};
+
+// ** FUNCTION PROTOTYPES ORDERED BY APPEARANCE BY CALL ** //
+bool parseIntList(const std::string &text, std::vector<int> &values);
+
+bool parseCount(const std::string &text, int &value);
+
+bool parseRange(const std::string &text, int &low, int &high);
+
+bool generateWorkload(const std::string &path, const GeneratorConfig &config);
+
+bool loadWorkloadImage(const std::string &path, Workload &workload);
+
+bool readCheckpoint(const std::string &path, const RunConfig &config, Workload &workload, Simulation &sim);
+
+void takeSection(const char *&cursor, void *data, size_t bytes);
+
+bool openJobStream(JobStream &stream, const std::string &path, Workload &workload);
+
+bool readStreamedJob(JobStream &stream);
+
+bool streamInt(JobStream &stream, int &value);
+
+bool parseJobFile(const std::string &path, Workload &workload);
+
+bool parsesWithArrivals(const char *cursor, const char *end, int num_processes);
+
+bool mapFile(const std::string &path, MappedFile &file);
+
+void unmapFile(MappedFile &file);
+
+bool scanInt(const char *&cursor, const char *end, int &value);
+
+void finishDecodingJob(const PCB &process, std::vector<Instruction> &instructionStream);
+
+void computeBurstEstimates(Workload &workload);
+
+void computeJobBurst(const Instruction *code, int num_instructions, int *remaining);
+
+void initSimulation(Simulation &sim, const Workload &workload, const RunConfig &config, int context_switch_time, int CPU_allocated_time);
+
+bool writeWorkloadImage(const std::string &path, Simulation &sim);
+
+void runSweep(const Workload &workload, const RunConfig &config, const std::vector<int> &switch_times, const std::vector<int> &allocated_times, unsigned int threads);
+
+SweepResult summarizeSimulation(const Simulation &sim);
+
+void runBenchmark(const Workload &workload, const RunConfig &config, double parse_seconds, int repeats);
+
+long peakResidentKB();
+
+void show_PCB(PCB process, const std::vector<Instruction> &instructionStream);
+
+void placeMemoryImage(Simulation &sim);
+
+void initAllocator(MemoryAllocator &memory, int capacity);
+
+bool allocateBlock(MemoryAllocator &memory, int size, int &address);
+
+void reserveBlock(MemoryAllocator &memory, int address, int size);
+
+void freeBlock(MemoryAllocator &memory, int address, int size);
+
+double externalFragmentation(const MemoryAllocator &memory);
+
+void initPagedMemory(Simulation &sim, const Workload &workload);
+
+void loadJobsToMemory(Simulation &sim);
+
+const Instruction *jobCode(const Simulation &sim, int first_instruction);
+
+const int *jobBurst(const Simulation &sim, int first_instruction);
+
+void releaseStreamedJob(Simulation &sim, int job, int slot);
+
+int addProcess(Simulation &sim, int base, int first_instruction, int arrival_time);
+
+void pushReady(Simulation &sim, int slot);
+
+void initScheduler(Scheduler &scheduler, int policy, int levels, int aging);
+
+int remainingBurst(const Simulation &sim, int slot);
+
+int burstLevel(const Simulation &sim, int burst);
+
+int popReady(Simulation &sim);
+
+int timeSlice(const Simulation &sim, const HotPCB &pcb);
+
+void startEventLog(EventLog &log, int level, int format, FILE *out);
+
+void logEvent(EventLog &log, int clock, int process_id, int type, int value);
+
+void logAdmission(EventLog &log, int clock, int process_id, int address, int waited);
+
+EventRecord &claimEvent(EventLog &log);
+void publishEvent(EventLog &log);
+
+void stopEventLog(EventLog &log);
+
+void eventWriter(EventLog *log);
+
+void formatEvent(const EventRecord &event, int format, std::string &text);
+
+void appendInt(std::string &text, long long value);
+
+void runSimulation(Simulation &sim);
+
+void admitArrivals(Simulation &sim);
+
+void takeCheckpoint(Simulation &sim);
+
+bool writeCheckpoint(const std::string &path, const Simulation &sim);
+
+int idleUntil(int clock, int next_event, int context_switch_time);
+
+void runSMP(Simulation &sim);
+
+bool dispatchCore(Simulation &sim, int c);
+
+template <bool Profiled>
+void runSingleCPU(Simulation &sim);
+
+template <bool Profiled>
+void executeCPU(Simulation &sim, int slot);
+
+void startSlice(Simulation &sim, int slot, CPUState &cpu, int core);
+
+template <bool Profiled>
+int runSlice(Simulation &sim, CPUState &cpu);
+
+template <bool Profiled>
+void finishSlice(Simulation &sim, int slot, const CPUState &cpu, int exit_reason);
+
+void mirrorPCB(Simulation &sim, int slot);
+
+void releasePages(Simulation &sim, int slot);
+
+template <bool Profiled>
+int runBranching(Simulation &sim, CPUState &cpu, const Instruction *code);
+
+template <bool Profiled>
+void countOpcode(Simulation &sim, int op_code);
+
+int computeCycles(CPUState &cpu, int cycles, bool split_compute);
+
+int pagedAddress(Simulation &sim, CPUState &cpu, int address, bool store);
+
+int pageFault(Simulation &sim, CPUState &cpu, int page, int address);
+
+int pageVictim(PagedMemory &paged, int page_policy);
+
+void evictPage(Simulation &sim, int frame);
+
+template <bool Profiled>
+int runThreaded(Simulation &sim, CPUState &cpu, const Instruction *code);
+
+template <bool Profiled>
+void checkIOWaitingQueue(Simulation &sim);
+
+void show_main_memory(std::vector<int> &mainMemory, int rows);
+
+void appendMemoryDump(std::string &text, const int *memory, int size, int mode);
+
+void appendMemoryDiff(std::string &text, const int *before, const int *after, int size);
+
+int scanMemory(const int *a, const int *b, int from, int size, bool equal);
+
+void writeText(const std::string &text);
+
+void show_memory_stats(const Simulation &sim);
+
+void show_paging_stats(const Simulation &sim);
+
+void show_core_stats(const Simulation &sim);
+
+void show_run_summary(const Simulation &sim, int format);
+
+void clearHistogram(LatencyHistogram &histogram);
+
+void recordLatency(LatencyHistogram &histogram, int value);
+
+int histogramBucket(int value);
+
+int bucketLowerBound(int bucket);
+
+int histogramPercentile(const LatencyHistogram &histogram, double percentile);
+
+bool writeMetrics(const std::string &path, int format, const Simulation &sim);
+
+void requestCheckpoint(int);
+
+unsigned long long hostTicks();
+
+void endProfilePhase(Profile &profile, int phase);
+
+bool reportProfile(const Simulation &sim, const std::string &path);
+
+int main(int argc, char** argv) 
+{
+    // Step 1: Read and parse input file into the workload every simulation shares
+    Workload workload;
+
+    // command line options, without --input the job file comes in on stdin
+    bool show_timing = false; // --time: report host time and instructions per second on stderr
+    std::string input_path;   // --input <file>: read the jobs from a file instead of stdin
+    std::string binary_path;  // --binary <file>: run a workload saved by --convert, skipping parse and load
+    std::string convert_path; // --convert <file>: save the parsed and loaded workload in binary form and exit
+    std::vector<int> sweep_switch_times;    // --sweep-cs a,b,c: context switch times to sweep over
+    std::vector<int> sweep_allocated_times; // --sweep-alloc a,b,c: CPU allocated times to sweep over
+    unsigned int sweep_threads = 0;         // --threads n: sweep worker threads, 0 means one per hardware thread
+    bool show_memory = false;               // --memory-stats: allocator and admission numbers after the run
+    int log_level = LOG_INSTRUCTIONS;       // --log-level 0|1|2: only the result, queue transitions, transitions and instructions
+    int log_format = LOG_FORMAT_TEXT;       // --log-format text|json
+    std::string generate_path;              // --generate <file|->: write a synthetic workload in the text format and exit
+    std::string metrics_path;               // --metrics <file>: per process and per queue numbers after the run
+    int metrics_format = METRICS_CSV;       // --metrics-format csv|json
+    bool benchmark = false;                 // --bench: time parse, load and execute separately instead of printing the run
+    int bench_repeats = 3;                  // --repeat n: load and execute runs for --bench, the best one is reported
+    std::string restore_path;               // --restore <file>: carry on from a --checkpoint instead of starting from a job file
+    bool streaming = false;                 // --stream: read jobs with arrival times as the clock reaches them, see JobStream
+    int memory_dump = DUMP_FULL;            // --memory-dump full|rle|none
+    std::string profile_path;               // --profile <file>: flat profile on stderr, folded stacks in <file>, see Profile
+    bool profiling = false;
+    bool memory_diff = false;               // --memory-diff: after the run, every word that changed since the load
+
+    // the run's defaults: the classic single CPU round robin on contiguous memory
+    RunConfig config;
+    config.dispatch = DISPATCH_THREADED;
+    config.policy = POLICY_RR;
+    config.levels = 4;
+    config.aging = 0;
+    config.cpus = 0;
+    config.migration_cost = 0;
+    config.host_threads = 0;
+    config.mirror_pcb = false;
+    config.split_compute = false;
+    config.paging = false;
+    config.page_policy = PAGE_FIFO;
+    config.frame_size = 16;
+    config.tlb_entries = 16;
+    config.page_fault_cost = 10;
+
+    // --generate defaults: a couple of thousand small jobs with an even opcode mix, sized like the sample jobs
+    GeneratorConfig generator;
+    generator.jobs = 2000;
+    generator.seed = 1;
+    generator.min_instructions = 1;
+    generator.max_instructions = 12;
+    for (int op = 0; op < 4; op++)
+    {
+        generator.mix[op] = 1;
+    }
+    generator.min_job_memory = 50;
+    generator.max_job_memory = 100;
+    generator.min_io_cycles = 1;
+    generator.max_io_cycles = 9;
+    generator.min_compute_cycles = 1;
+    generator.max_compute_cycles = 9;
+    generator.max_memory = 0;
+    generator.context_switch_time = 2;
+    generator.CPU_allocated_time = 5;
+    generator.arrivals = false;
+    generator.min_arrival_gap = generator.max_arrival_gap = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--dispatch" && i + 1 < argc) // --dispatch branch|threaded
+        {
+            std::string mode = argv[++i];
+            if (mode == "branch")
+            {
+                config.dispatch = DISPATCH_BRANCH;
+            }
+            else if (mode == "threaded")
+            {
+                config.dispatch = DISPATCH_THREADED;
+            }
+            else
+            {
+                std::cerr << "ERROR: unknown dispatch mode " << mode << " (expected branch or threaded)" << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--scheduler" && i + 1 < argc) // --scheduler rr|fcfs|srtf|priority|mlfq
+        {
+            std::string policy = argv[++i];
+            config.policy = -1;
+            for (int p = POLICY_RR; p <= POLICY_MLFQ; p++)
+            {
+                if (policy == scheduler_names[p])
+                {
+                    config.policy = p;
+                }
+            }
+            if (config.policy < 0)
+            {
+                std::cerr << "ERROR: unknown scheduler " << policy << " (expected rr, fcfs, srtf, priority or mlfq)" << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--levels" && i + 1 < argc)
+        {
+            if (!parseCount(argv[++i], config.levels) || config.levels < 1 || config.levels > 32)
+            {
+                std::cerr << "ERROR: --levels expects 1 to 32" << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--aging" && i + 1 < argc)
+        {
+            if (!parseCount(argv[++i], config.aging))
+            {
+                std::cerr << "ERROR: --aging expects a non negative number" << "\n";
+                return 1;
+            }
+        }
+        else if ((arg == "--cpus" || arg == "--migration-cost" || arg == "--host-threads") && i + 1 < argc)
+        {
+            int value;
+            if (!parseCount(argv[++i], value))
+            {
+                std::cerr << "ERROR: " << arg << " expects a non negative number" << "\n";
+                return 1;
+            }
+
+            if (arg == "--cpus") config.cpus = value;
+            else if (arg == "--migration-cost") config.migration_cost = value;
+            else config.host_threads = value;
+        }
+        else if (arg == "--input" && i + 1 < argc)
+        {
+            input_path = argv[++i];
+        }
+        else if (arg == "--binary" && i + 1 < argc)
+        {
+            binary_path = argv[++i];
+        }
+        else if (arg == "--convert" && i + 1 < argc)
+        {
+            convert_path = argv[++i];
+        }
+        else if ((arg == "--sweep-cs" || arg == "--sweep-alloc") && i + 1 < argc)
+        {
+            std::vector<int> &values = (arg == "--sweep-cs") ? sweep_switch_times : sweep_allocated_times;
+            if (!parseIntList(argv[++i], values))
+            {
+                std::cerr << "ERROR: " << arg << " expects a comma separated list of non negative numbers" << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            int value;
+            if (!parseCount(argv[++i], value))
+            {
+                std::cerr << "ERROR: --threads expects a non negative number" << "\n";
+                return 1;
+            }
+            sweep_threads = value;
+        }
+        else if (arg == "--log-level" && i + 1 < argc)
+        {
+            if (!parseCount(argv[++i], log_level) || log_level > LOG_INSTRUCTIONS)
+            {
+                std::cerr << "ERROR: --log-level expects 0, 1 or 2" << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--log-format" && i + 1 < argc)
+        {
+            std::string format = argv[++i];
+            if (format == "text")
+            {
+                log_format = LOG_FORMAT_TEXT;
+            }
+            else if (format == "json")
+            {
+                log_format = LOG_FORMAT_JSON;
+            }
+            else
+            {
+                std::cerr << "ERROR: unknown log format " << format << " (expected text or json)" << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--memory-dump" && i + 1 < argc)
+        {
+            std::string mode = argv[++i];
+            if (mode == "full")
+            {
+                memory_dump = DUMP_FULL;
+            }
+            else if (mode == "rle")
+            {
+                memory_dump = DUMP_RLE;
+            }
+            else if (mode == "none")
+            {
+                memory_dump = DUMP_NONE;
+            }
+            else
+            {
+                std::cerr << "ERROR: unknown memory dump " << mode << " (expected full, rle or none)" << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--memory-diff")
+        {
+            memory_diff = true;
+        }
+        else if (arg == "--profile" && i + 1 < argc)
+        {
+            profile_path = argv[++i];
+            profiling = true;
+        }
+        else if (arg == "--generate" && i + 1 < argc)
+        {
+            generate_path = argv[++i];
+        }
+        else if ((arg == "--jobs" || arg == "--seed" || arg == "--main-memory" || arg == "--cs" || arg == "--alloc" || arg == "--repeat") && i + 1 < argc)
+        {
+            int value;
+            if (!parseCount(argv[++i], value) || ((arg == "--jobs" || arg == "--repeat") && value == 0))
+            {
+                std::cerr << "ERROR: " << arg << " expects a positive number" << "\n";
+                return 1;
+            }
+
+            if (arg == "--jobs") generator.jobs = value;
+            else if (arg == "--seed") generator.seed = value;
+            else if (arg == "--main-memory") generator.max_memory = value;
+            else if (arg == "--cs") generator.context_switch_time = value;
+            else if (arg == "--alloc") generator.CPU_allocated_time = value;
+            else bench_repeats = value;
+        }
+        else if ((arg == "--instructions" || arg == "--job-memory" || arg == "--io-cycles" || arg == "--compute-cycles" || arg == "--arrivals") && i + 1 < argc)
+        {
+            int *low = &generator.min_instructions, *high = &generator.max_instructions;
+            if (arg == "--job-memory")
+            {
+                low = &generator.min_job_memory;
+                high = &generator.max_job_memory;
+            }
+            else if (arg == "--io-cycles")
+            {
+                low = &generator.min_io_cycles;
+                high = &generator.max_io_cycles;
+            }
+            else if (arg == "--compute-cycles")
+            {
+                low = &generator.min_compute_cycles;
+                high = &generator.max_compute_cycles;
+            }
+            else if (arg == "--arrivals")
+            {
+                low = &generator.min_arrival_gap;
+                high = &generator.max_arrival_gap;
+                generator.arrivals = true;
+            }
+
+            if (!parseRange(argv[++i], *low, *high))
+            {
+                std::cerr << "ERROR: " << arg << " expects min,max or a single number" << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--mix" && i + 1 < argc)
+        {
+            std::vector<int> weights;
+            if (!parseIntList(argv[++i], weights) || weights.size() != 4 || weights[0] + weights[1] + weights[2] + weights[3] == 0)
+            {
+                std::cerr << "ERROR: --mix expects four weights for compute,print,store,load" << "\n";
+                return 1;
+            }
+            std::copy(weights.begin(), weights.end(), generator.mix);
+        }
+        else if (arg == "--metrics" && i + 1 < argc)
+        {
+            metrics_path = argv[++i];
+        }
+        else if (arg == "--metrics-format" && i + 1 < argc)
+        {
+            std::string format = argv[++i];
+            if (format == "csv")
+            {
+                metrics_format = METRICS_CSV;
+            }
+            else if (format == "json")
+            {
+                metrics_format = METRICS_JSON;
+            }
+            else
+            {
+                std::cerr << "ERROR: unknown metrics format " << format << " (expected csv or json)" << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--bench")
+        {
+            benchmark = true;
+        }
+        else if (arg == "--paging" && i + 1 < argc) // --paging fifo|clock|lfu
+        {
+            std::string policy = argv[++i];
+            config.page_policy = -1;
+            for (int p = PAGE_FIFO; p <= PAGE_LFU; p++)
+            {
+                if (policy == page_policy_names[p])
+                {
+                    config.page_policy = p;
+                }
+            }
+            if (config.page_policy < 0)
+            {
+                std::cerr << "ERROR: unknown page replacement policy " << policy << " (expected fifo, clock or lfu)" << "\n";
+                return 1;
+            }
+            config.paging = true;
+        }
+        else if ((arg == "--frame-size" || arg == "--tlb" || arg == "--page-fault-cost") && i + 1 < argc)
+        {
+            int value;
+            if (!parseCount(argv[++i], value) || (arg != "--page-fault-cost" && (value == 0 || (value & (value - 1)) != 0)))
+            {
+                std::cerr << "ERROR: " << arg << (arg == "--page-fault-cost" ? " expects a non negative number" : " expects a power of two") << "\n";
+                return 1;
+            }
+
+            if (arg == "--frame-size") config.frame_size = value;
+            else if (arg == "--tlb") config.tlb_entries = value;
+            else config.page_fault_cost = value;
+        }
+        else if ((arg == "--checkpoint" || arg == "--restore") && i + 1 < argc)
+        {
+            (arg == "--checkpoint" ? checkpoint_path : restore_path) = argv[++i];
+        }
+        else if (arg == "--checkpoint-every" && i + 1 < argc)
+        {
+            if (!parseCount(argv[++i], checkpoint_every))
+            {
+                std::cerr << "ERROR: --checkpoint-every expects a non negative number" << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--stream")
+        {
+            streaming = true;
+        }
+        else if (arg == "--split-compute")
+        {
+            config.split_compute = true;
+        }
+        else if (arg == "--mirror-pcb")
+        {
+            config.mirror_pcb = true;
+        }
+        else if (arg == "--memory-stats")
+        {
+            show_memory = true;
+        }
+        else if (arg == "--time")
+        {
+            show_timing = true;
+        }
+        else
+        {
+            std::cerr << "ERROR: unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (config.cpus > 0 && config.policy != POLICY_RR && config.policy != POLICY_FCFS)
+    {
+        std::cerr << "ERROR: --cpus runs per core FIFO run queues, use it with --scheduler rr or fcfs" << "\n";
+        return 1;
+    }
+
+    if (config.paging && (!binary_path.empty() || !convert_path.empty()))
+    {
+        std::cerr << "ERROR: --paging admits every job into its own backing store, it does not run from or write a memory image" << "\n";
+        return 1;
+    }
+
+    if ((!checkpoint_path.empty() || !restore_path.empty()) && config.cpus > 0)
+    {
+        std::cerr << "ERROR: --checkpoint and --restore snapshot the single CPU loop, they do not work with --cpus" << "\n";
+        return 1;
+    }
+
+    if (!restore_path.empty() && (!binary_path.empty() || !input_path.empty() || !convert_path.empty() || !generate_path.empty() ||
+        benchmark || !sweep_switch_times.empty() || !sweep_allocated_times.empty()))
+    {
+        std::cerr << "ERROR: --restore resumes one run from its checkpoint, there is no job file to read and nothing else to do" << "\n";
+        return 1;
+    }
+
+#ifdef SIGUSR1
+    if (!checkpoint_path.empty())
+    {
+        std::signal(SIGUSR1, requestCheckpoint); // from the start, a request that comes in while parsing is taken at the first dispatch
+    }
+#endif
+
+    if (streaming && (!binary_path.empty() || !convert_path.empty() || !restore_path.empty() || !checkpoint_path.empty() || benchmark ||
+        !sweep_switch_times.empty() || !sweep_allocated_times.empty() || config.cpus > 0 || config.paging))
+    {
+        std::cerr << "ERROR: --stream reads the input once as a single CPU run goes, it does not combine with --binary, --convert, "
+                  << "--checkpoint, --restore, --bench, sweeps, --cpus or --paging" << "\n";
+        return 1;
+    }
+
+    if (profiling && (config.cpus > 0 || streaming || benchmark || !sweep_switch_times.empty() || !sweep_allocated_times.empty() ||
+        !convert_path.empty() || !generate_path.empty()))
+    {
+        std::cerr << "ERROR: --profile follows one single CPU run from parse to report, it does not combine with --cpus, --stream, "
+                  << "--bench, sweeps, --convert or --generate" << "\n";
+        return 1;
+    }
+
+    if (!generate_path.empty())
+    {
+        return generateWorkload(generate_path, generator) ? 0 : 1;
+    }
+
+    Simulation sim; // the run: set up by initSimulation once the jobs are parsed, or straight out of a --restore checkpoint
+    JobStream job_stream;
+    Profile profile = Profile(); // zeroed, every counter only ever adds
+
+    std::chrono::steady_clock::time_point parse_start = std::chrono::steady_clock::now();
+    if (profiling)
+    {
+        profile.start_time = parse_start;
+        profile.start_ticks = profile.mark = hostTicks();
+    }
+
+    if (!restore_path.empty())
+    {
+        // the checkpoint has the decoded workload and the whole machine state, nothing to parse or load
+        if (!readCheckpoint(restore_path, config, workload, sim))
+        {
+            return 1;
+        }
+    }
+    else if (streaming)
+    {
+        // only the header for now, the jobs are read as the clock reaches their arrival times
+        if (!openJobStream(job_stream, input_path, workload))
+        {
+            return 1;
+        }
+    }
+    else if (!binary_path.empty())
+    {
+        // binary workload: header, decoded instructions and the loaded memory image come straight out of the file
+        if (!loadWorkloadImage(binary_path, workload))
+        {
+            return 1;
+        }
+    }
+    else if (!input_path.empty())
+    {
+        // file path mode: map the file and parse it in place, no iostreams and no per-line strings
+        if (!parseJobFile(input_path, workload))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        // read in data from file
+        std::cin >> workload.max_memory;
+        std::cin >> workload.context_switch_time;
+        std::cin >> workload.CPU_allocated_time;
+        std::cin >> workload.num_processes;
+
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // this ignores any extra characters in the buffer namely the new line character, which would be picked up by the getline function below
+
+        /*
+        * This loop will fun for the number of process in the file (we know this value as it's the 2nd number in the file) and we will use a string to grab the line
+        * we then create a string stream from it which allows for us to extract data from the file. This wasn't needed for the sample files but in the larger files when the text
+        * wraps we pick up the new line character and it causes issues. This allows us to ignore the new line character and just read in the data.
+        */
+        for (unsigned int i = 0; i < workload.num_processes; i++) 
+        {
+            std::string line;
+            std::getline(std::cin, line);  // grab the entire line
+
+            std::istringstream ss(line);  // create a string stream to parse the line
+
+            int process_id, max_memory_needed, number_of_instructions;  
+            ss >> process_id >> max_memory_needed >> number_of_instructions;   // read in first 3 variables of process
+
+            PCB process;
+            process.process_id = process_id;
+            process.max_memory_needed = max_memory_needed;
+            process.state = 0; 
+            process.program_counter = 0;
+            process.memory_limit = process.max_memory_needed;
+            process.CPU_cycles_used = 0;
+            process.register_value = 0;
+            process.first_instruction = workload.instructionStream.size();
+            process.num_instructions = number_of_instructions;
+            process.arrival_time = 0;
+    
+
+            // iterate the instructions of each process, decoding them straight into the shared instruction stream
+            for (unsigned int j = 0; j < number_of_instructions; j++) 
+            {
+                Instruction current_instruction;
+                current_instruction.operand_1 = 0;
+                current_instruction.operand_2 = 0;
+                current_instruction.data_offset = 0; // filled in by finishDecodingJob
+
+                ss >> current_instruction.op_code;  // read in opcode based on that read in data of instruction
+
+                if (current_instruction.op_code == 1) // 1: compute, iterations then cycles
+                {
+                    ss >> current_instruction.operand_1 >> current_instruction.operand_2;
+                } 
+                if (current_instruction.op_code == 2) // 2:  print, cycles
+                { 
+                    ss >> current_instruction.operand_1;
+                } 
+                if (current_instruction.op_code == 3) // 3:  store, value then address
+                {   
+                    ss >> current_instruction.operand_1 >> current_instruction.operand_2;
+                }
+                if (current_instruction.op_code == 4) // 4:  load, address
+                {
+                    ss >> current_instruction.operand_1;
+                }
+
+                workload.instructionStream.push_back(current_instruction);
+            }
+            finishDecodingJob(process, workload.instructionStream);
+
+            // keep the PCB, every simulation's new-job-queue starts from these
+            workload.jobs.push_back(process);  
+        }
+    }
+
+    if (restore_path.empty())
+    {
+        computeBurstEstimates(workload);
+    }
+
+    if (config.paging && restore_path.empty() && workload.max_memory < config.frame_size) // a checkpoint's frames are checked as it is read
+    {
+        std::cerr << "ERROR: --paging needs room for at least one frame, max memory " << workload.max_memory << " is smaller than a " << config.frame_size << " word frame" << "\n";
+        return 1;
+    }
+
+    double parse_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - parse_start).count();
+
+    if (profiling)
+    {
+        endProfilePhase(profile, PROFILE_PARSE);
+    }
+
+    if (benchmark)
+    {
+        runBenchmark(workload, config, parse_seconds, bench_repeats);
+        return 0;
+    }
+
+    if (!convert_path.empty())
+    {
+        // --convert: load the parsed jobs exactly as a run would and save the result instead of running it
+        initSimulation(sim, workload, config, workload.context_switch_time, workload.CPU_allocated_time);
+        return writeWorkloadImage(convert_path, sim) ? 0 : 1;
+    }
+
+    if (!sweep_switch_times.empty() || !sweep_allocated_times.empty())
+    {
+        // batch mode: one quiet simulation per parameter pair, the values from the file fill in whichever list is missing
+        if (sweep_switch_times.empty())
+        {
+            sweep_switch_times.push_back(workload.context_switch_time);
+        }
+        if (sweep_allocated_times.empty())
+        {
+            sweep_allocated_times.push_back(workload.CPU_allocated_time);
+        }
+        runSweep(workload, config, sweep_switch_times, sweep_allocated_times, sweep_threads);
+        return 0;
+    }
+
+    // a restored run prints only what comes after its checkpoint, so the two outputs together read like one run
+    if (restore_path.empty())
+    {
+        std::cout << "max memory: " << workload.max_memory << std::endl;
+        std::cout << "context switch time: " << workload.context_switch_time << std::endl;
+        std::cout << "CPU allocated time: " << workload.CPU_allocated_time << std::endl;
+        std::cout << "num processes: " << workload.num_processes << std::endl;
+        std::cout << std::endl;
+
+
+    
+        // Step 2: Load jobs into main memory
+        initSimulation(sim, workload, config, workload.context_switch_time, workload.CPU_allocated_time);
+        if (streaming)
+        {
+            sim.stream = &job_stream;
+            admitArrivals(sim); // whatever arrives at 0 is loaded now, like a whole input would be
+        }
+        if (profiling)
+        {
+            endProfilePhase(profile, PROFILE_LOAD);
+        }
+
+        // print main memory, formatted into one buffer and written at once: a big memory is millions of lines
+        if (memory_dump != DUMP_NONE)
+        {
+            std::string dump;
+            appendMemoryDump(dump, sim.mainMemory.data(), sim.mainMemory.size(), memory_dump);
+            writeText(dump);
+        }
+    }
+
+    std::vector<int> memory_before; // --memory-diff: main memory as the run starts
+    if (memory_diff)
+    {
+        memory_before = sim.mainMemory;
+    }
+    if (profiling)
+    {
+        endProfilePhase(profile, PROFILE_DUMP); // a restore was timed as parse, it has no load or dump
+    }
+
+    if (!checkpoint_path.empty())
+    {
+        sim.next_checkpoint = checkpoint_every > 0 ? sim.CPU_clock + checkpoint_every : std::numeric_limits<int>::max();
+    }
+
+
+    // Step 4: Process execution, round robin
+    EventLog event_log;
+    if (log_level > LOG_OFF)
+    {
+        std::cout.flush(); // everything printed so far has to land before the writer thread starts writing
+        startEventLog(event_log, log_level, log_format, stdout);
+        sim.log = &event_log;
+        sim.log_level = log_level;
+    }
+
+    std::chrono::steady_clock::time_point execution_start = std::chrono::steady_clock::now();
+
+    if (profiling)
+    {
+        sim.profile = &profile;
+    }
+    runSimulation(sim);
+    if (profiling)
+    {
+        endProfilePhase(profile, PROFILE_RUN);
+    }
+
+    if (log_level > LOG_OFF)
+    {
+        stopEventLog(event_log); // drains the ring, so the stats below come after the last event
+    }
+    else
+    {
+        show_run_summary(sim, log_format); // log off still prints what the run came to
+    }
+
+    if (memory_diff)
+    {
+        std::string diff;
+        appendMemoryDiff(diff, memory_before.data(), sim.mainMemory.data(), sim.mainMemory.size());
+        writeText(diff);
+    }
+
+    if (show_memory)
+    {
+        if (sim.config.paging)
+        {
+            show_paging_stats(sim);
+        }
+        else
+        {
+            show_memory_stats(sim);
+        }
+    }
+
+    if (!sim.cores.empty())
+    {
+        show_core_stats(sim);
+    }
+
+    if (!metrics_path.empty() && !writeMetrics(metrics_path, metrics_format, sim))
+    {
+        return 1;
+    }
+
+    if (profiling)
+    {
+        endProfilePhase(profile, PROFILE_REPORT);
+        if (!reportProfile(sim, profile_path))
+        {
+            return 1;
+        }
+    }
+
+    if (show_timing)
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - execution_start).count();
+        std::cerr << "dispatch: " << (sim.config.dispatch == DISPATCH_THREADED ? "threaded" : "branch")
+                  << ", instructions: " << sim.instructions_executed
+                  << ", host seconds: " << seconds
+                  << ", instructions/sec: " << (seconds > 0 ? sim.instructions_executed / seconds : 0) << "\n";
+    }
+
+    if (streaming && job_stream.in != stdin)
+    {
+        fclose(job_stream.in);
+    }
+ 
+
+    return 0;
+} // END OF MAIN
+
+// "lo,hi" or just "n" for lo = hi = n
+bool parseRange(const std::string &text, int &low, int &high)
+{
+    std::vector<int> values;
+    if (!parseIntList(text, values) || values.empty() || values.size() > 2)
+    {
+        return false;
+    }
+    low = values.front();
+    high = values.back();
+    return low <= high;
+} // END FUNCTION
+
+/*
+* --generate: writes a seeded synthetic workload in the same text format the simulator reads on stdin. Draws are plain
+* mt19937 outputs taken modulo the range, not std:: distributions, so a seed gives the same file with every compiler.
+* Each job's logical memory is raised to hold its own instructions and operands, so nothing reads as -1, and stores and
+* loads address the scratch words past the data segment. path "-" writes to stdout.
+*/
+bool generateWorkload(const std::string &path, const GeneratorConfig &config)
+{
+    FILE *out = (path == "-") ? stdout : fopen(path.c_str(), "wb");
+    if (!out)
+    {
+        std::cerr << "ERROR: could not create workload file " << path << "\n";
+        return false;
+    }
+
+    std::mt19937 random(config.seed);
+    auto draw = [&random](int low, int high) // inclusive
+    {
+        return low + (int)(random() % (unsigned int)(high - low + 1));
+    };
+    int mix_total = config.mix[0] + config.mix[1] + config.mix[2] + config.mix[3];
+
+    std::string jobs;
+    long long memory_for_all = 0;
+    bool written = true;
+
+    std::string header;
+    if (config.arrivals)
+    {
+        // a stream goes out as it is generated, so the header comes first and cannot be sized to fit every job: by
+        // default it holds 64 of the biggest jobs the ranges allow at once
+        int biggest_job = 10 + std::max(config.max_job_memory, 3 * config.max_instructions + 1);
+        appendInt(header, config.max_memory > 0 ? config.max_memory : 64LL * biggest_job);
+        header += ' ';
+        appendInt(header, config.context_switch_time);
+        header += ' ';
+        appendInt(header, config.CPU_allocated_time);
+        header += '\n';
+        appendInt(header, config.jobs);
+        header += '\n';
+        written = fwrite(header.data(), 1, header.size(), out) == header.size();
+    }
+    int arrival = 0;
+
+    for (int pid = 1; pid <= config.jobs && written; pid++)
+    {
+        int num_instructions = draw(config.min_instructions, config.max_instructions);
+
+        // pick the opcodes first, their operand count decides where the scratch area starts
+        std::vector<int> op_codes(num_instructions);
+        int data_size = 0;
+        for (int i = 0; i < num_instructions; i++)
+        {
+            int pick = draw(0, mix_total - 1);
+            int op_code = 1;
+            while (pick >= config.mix[op_code - 1])
+            {
+                pick -= config.mix[op_code - 1];
+                op_code++;
+            }
+            op_codes[i] = op_code;
+            data_size += (op_code == 1 || op_code == 3) ? 2 : 1;
+        }
+
+        int scratch_start = num_instructions + data_size;
+        int max_memory_needed = std::max(draw(config.min_job_memory, config.max_job_memory), scratch_start + 1);
+        memory_for_all += 10 + max_memory_needed;
+
+        if (config.arrivals)
+        {
+            appendInt(jobs, arrival);
+            jobs += ' ';
+            arrival += draw(config.min_arrival_gap, config.max_arrival_gap);
+        }
+        appendInt(jobs, pid);
+        jobs += ' ';
+        appendInt(jobs, max_memory_needed);
+        jobs += ' ';
+        appendInt(jobs, num_instructions);
+
+        for (int i = 0; i < num_instructions; i++)
+        {
+            jobs += ' ';
+            appendInt(jobs, op_codes[i]);
+            jobs += ' ';
+            if (op_codes[i] == 1) // compute: iterations, cycles
+            {
+                appendInt(jobs, draw(1, 5));
+                jobs += ' ';
+                appendInt(jobs, draw(config.min_compute_cycles, config.max_compute_cycles));
+            }
+            else if (op_codes[i] == 2) // print: cycles
+            {
+                appendInt(jobs, draw(config.min_io_cycles, config.max_io_cycles));
+            }
+            else if (op_codes[i] == 3) // store: value, address
+            {
+                appendInt(jobs, draw(0, 99));
+                jobs += ' ';
+                appendInt(jobs, draw(scratch_start, max_memory_needed - 1));
+            }
+            else // load: address
+            {
+                appendInt(jobs, draw(scratch_start, max_memory_needed - 1));
+            }
+        }
+        jobs += '\n';
+
+        if (config.arrivals && jobs.size() >= (1 << 20)) // a pipe reader gets the jobs as they are made
+        {
+            written = fwrite(jobs.data(), 1, jobs.size(), out) == jobs.size();
+            jobs.clear();
+        }
+    }
+
+    if (!config.arrivals)
+    {
+        appendInt(header, config.max_memory > 0 ? config.max_memory : memory_for_all);
+        header += ' ';
+        appendInt(header, config.context_switch_time);
+        header += ' ';
+        appendInt(header, config.CPU_allocated_time);
+        header += '\n';
+        appendInt(header, config.jobs);
+        header += '\n';
+        written = fwrite(header.data(), 1, header.size(), out) == header.size();
+    }
+
+    written = written && fwrite(jobs.data(), 1, jobs.size(), out) == jobs.size();
+    written = (out == stdout ? fflush(out) : fclose(out)) == 0 && written;
+
+    if (!written)
+    {
+        std::cerr << "ERROR: short write to " << path << "\n";
+        return false;
+    }
+    return true;
+} // END FUNCTION
+
+// splits "1,2,5" into its numbers
+bool parseIntList(const std::string &text, std::vector<int> &values)
+{
+    const char *cursor = text.data();
+    const char *end = cursor + text.size();
+
+    while (cursor < end)
+    {
+        int value;
+        std::from_chars_result result = std::from_chars(cursor, end, value);
+        if (result.ec != std::errc() || value < 0)
+        {
+            return false;
+        }
+        values.push_back(value);
+
+        cursor = result.ptr;
+        if (cursor < end && *cursor++ != ',')
+        {
+            return false;
+        }
+    }
+    return !values.empty();
+} // END FUNCTION
+
+// one non negative number and nothing after it, for the numeric options: "x", "-3" or "4k" are refused, not thrown on
+bool parseCount(const std::string &text, int &value)
+{
+    const char *end = text.data() + text.size();
+    int parsed;
+    std::from_chars_result result = std::from_chars(text.data(), end, parsed);
+    if (result.ec != std::errc() || result.ptr != end || parsed < 0)
+    {
+        return false;
+    }
+    value = parsed;
+    return true;
+} // END FUNCTION
+
+
+// maps a --convert file and bulk copies its memory image and instruction stream into the workload
+bool loadWorkloadImage(const std::string &path, Workload &workload)
+{
+    MappedFile file;
+    if (!mapFile(path, file))
+    {
+        std::cerr << "ERROR: could not open binary workload " << path << "\n";
+        return false;
+    }
+
+    WorkloadHeader header;
+    if (file.size < sizeof(header))
+    {
+        std::cerr << "ERROR: " << path << " is too small to be a binary workload" << "\n";
+        unmapFile(file);
+        return false;
+    }
+    std::memcpy(&header, file.data, sizeof(header));
+
+    if (header.magic != WORKLOAD_MAGIC || header.version != WORKLOAD_VERSION)
+    {
+        std::cerr << "ERROR: " << path << " is not a version " << WORKLOAD_VERSION << " binary workload" << "\n";
+        unmapFile(file);
+        return false;
+    }
+
+    size_t process_bytes = (size_t)header.num_processes * sizeof(WorkloadProcess);
+    size_t instruction_bytes = (size_t)header.num_instructions * sizeof(Instruction);
+    size_t image_bytes = (size_t)header.image_words * sizeof(int);
+
+    if (header.num_processes < 0 || header.num_instructions < 0 || header.image_words < 0 || header.image_words > header.max_memory ||
+        file.size != sizeof(header) + process_bytes + instruction_bytes + image_bytes)
+    {
+        std::cerr << "ERROR: " << path << " is truncated or corrupt" << "\n";
+        unmapFile(file);
+        return false;
+    }
+
+    const char *processes = file.data + sizeof(header);
+    const char *instructions = processes + process_bytes;
+    const char *image = instructions + instruction_bytes;
+
+    workload.max_memory = header.max_memory;
+    workload.context_switch_time = header.context_switch_time;
+    workload.CPU_allocated_time = header.CPU_allocated_time;
+    workload.num_processes = header.num_processes;
+
+    workload.image_processes.resize(header.num_processes);
+    std::memcpy(workload.image_processes.data(), processes, process_bytes);
+
+    workload.instructionStream.resize(header.num_instructions);
+    std::memcpy(workload.instructionStream.data(), instructions, instruction_bytes);
+
+    workload.memory_image.resize(header.image_words);
+    std::memcpy(workload.memory_image.data(), image, image_bytes);
+
+    for (int i = 0; i < header.num_processes; i++)
+    {
+        const WorkloadProcess &process = workload.image_processes[i];
+
+        bool bad_entry = process.main_memory_base < -1 || process.max_memory_needed < 0 || process.first_instruction < 0 || process.num_instructions < 0 ||
+                         process.first_instruction > header.num_instructions - process.num_instructions;
+        if (!bad_entry && process.main_memory_base >= 0)
+        {
+            // a loaded job's 10 PCB words and its block have to fit, and addProcess reads the PCB words, so they have to agree with the entry
+            int base = process.main_memory_base;
+            const int *pcb = workload.memory_image.data() + base;
+            bad_entry = base > header.image_words - 10 || process.max_memory_needed > header.max_memory - 10 - base ||
+                        pcb[3] != base + 10 || pcb[4] != base + 10 + process.num_instructions || pcb[8] != process.max_memory_needed;
+        }
+
+        // every operand the loader would place has to land inside the job's data segment, unless the decoder already
+        // turned it into -1 for falling past the end
+        int data_size = process.max_memory_needed - process.num_instructions;
+        for (int j = 0; j < process.num_instructions && !bad_entry; j++)
+        {
+            const Instruction &instruction = workload.instructionStream[process.first_instruction + j];
+            int width = (instruction.op_code == 1 || instruction.op_code == 3) ? 2 : 1;
+            bad_entry = instruction.data_offset < 0 || (instruction.data_offset > data_size - width && instruction.operand_1 != -1);
+        }
+
+        if (bad_entry)
+        {
+            std::cerr << "ERROR: " << path << " has a bad process table entry " << i << "\n";
+            unmapFile(file);
+            return false;
+        }
+    }
+
+    unmapFile(file);
+    return true;
+} // END FUNCTION
+
+/*
+* --restore: rebuilds the workload and the simulation exactly as writeCheckpoint saw them, and puts the run's parameters
+* back in its RunConfig. Nothing is parsed and loadJobsToMemory never runs, it is one mapping and a copy per section.
+*/
+bool readCheckpoint(const std::string &path, const RunConfig &config, Workload &workload, Simulation &sim)
+{
+    MappedFile file;
+    if (!mapFile(path, file))
+    {
+        std::cerr << "ERROR: could not open checkpoint " << path << "\n";
+        return false;
+    }
+
+    CheckpointHeader header;
+    if (file.size < sizeof(header))
+    {
+        std::cerr << "ERROR: " << path << " is too small to be a checkpoint" << "\n";
+        unmapFile(file);
+        return false;
+    }
+    std::memcpy(&header, file.data, sizeof(header));
+
+    if (header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION)
+    {
+        std::cerr << "ERROR: " << path << " is not a version " << CHECKPOINT_VERSION << " checkpoint" << "\n";
+        unmapFile(file);
+        return false;
+    }
+
+    size_t expected = sizeof(header) + (size_t)header.instructions * (sizeof(Instruction) + sizeof(int)) + (size_t)header.max_memory * sizeof(int)
+                    + (size_t)header.processes * (sizeof(HotPCB) + sizeof(ProcessRecord)) + (size_t)header.new_jobs * sizeof(PCB)
+                    + (size_t)header.ready * sizeof(SRTFEntry) + (size_t)header.IO_waiting * sizeof(IOWaitEntry)
+                    + (size_t)header.free_blocks * 2 * sizeof(int) + sizeof(QueueMetrics);
+    if (header.paging)
+    {
+        expected += (size_t)header.backing_words * sizeof(int) + (size_t)header.pages * sizeof(int) + (size_t)header.tlb_entries * sizeof(TLBEntry)
+                  + (size_t)header.frames * sizeof(PageFrame) + (size_t)header.free_frames * sizeof(int);
+    }
+
+    if (header.instructions < 0 || header.max_memory < 0 || header.processes < 0 || header.new_jobs < 0 || header.ready < 0 ||
+        header.IO_waiting < 0 || header.free_blocks < 0 || header.backing_words < 0 || header.pages < 0 || header.frames < 0 ||
+        header.free_frames < 0 || header.levels < 1 || header.levels > 32 || header.policy < POLICY_RR || header.policy > POLICY_MLFQ ||
+        file.size != expected)
+    {
+        std::cerr << "ERROR: " << path << " is truncated or corrupt" << "\n";
+        unmapFile(file);
+        return false;
+    }
+
+    // the parameters that go back into the RunConfig get the checks their options get, the pager uses them as masks and indexes
+    if (header.aging < 0 || header.page_policy < PAGE_FIFO || header.page_policy > PAGE_LFU || header.page_fault_cost < 0 ||
+        header.frame_size <= 0 || (header.frame_size & (header.frame_size - 1)) != 0 ||
+        (header.paging && (header.tlb_entries <= 0 || (header.tlb_entries & (header.tlb_entries - 1)) != 0 ||
+                           header.frames < 1 || header.frames != header.max_memory / header.frame_size)))
+    {
+        std::cerr << "ERROR: " << path << " is corrupt, its paging or scheduler parameters are out of range" << "\n";
+        unmapFile(file);
+        return false;
+    }
+
+    // the run's parameters, the ones a checkpoint does not record (the dispatch core, host threads) from this command line
+    sim.config = config;
+    sim.config.policy = header.policy;
+    sim.config.levels = header.levels;
+    sim.config.aging = header.aging;
+    sim.config.split_compute = header.split_compute != 0;
+    sim.config.mirror_pcb = header.mirror_pcb != 0;
+    sim.config.paging = header.paging != 0;
+    sim.config.page_policy = header.page_policy;
+    sim.config.frame_size = header.frame_size;
+    sim.config.tlb_entries = header.tlb_entries;
+    sim.config.page_fault_cost = header.page_fault_cost;
+
+    const char *cursor = file.data + sizeof(header);
+
+    workload.max_memory = header.max_memory;
+    workload.context_switch_time = header.context_switch_time;
+    workload.CPU_allocated_time = header.CPU_allocated_time;
+    workload.num_processes = header.num_processes;
+    workload.instructionStream.resize(header.instructions);
+    takeSection(cursor, workload.instructionStream.data(), header.instructions * sizeof(Instruction));
+    workload.remainingBurst.resize(header.instructions);
+    takeSection(cursor, workload.remainingBurst.data(), header.instructions * sizeof(int));
+
+    sim.workload = &workload;
+    sim.stream = nullptr;
+    sim.next_checkpoint = -1;
+    sim.CPU_clock = header.CPU_clock;
+    sim.context_switch_time = header.context_switch_time;
+    sim.CPU_allocated_time = header.CPU_allocated_time;
+    sim.log = nullptr;
+    sim.log_level = LOG_OFF;
+    sim.profile = nullptr;
+    sim.rejected_jobs = header.rejected_jobs;
+    sim.IO_sequence = header.IO_sequence;
+    sim.instructions_executed = header.instructions_executed;
+
+    sim.mainMemory.resize(header.max_memory);
+    takeSection(cursor, sim.mainMemory.data(), header.max_memory * sizeof(int));
+
+    sim.pcbTable.resize(header.processes);
+    takeSection(cursor, sim.pcbTable.data(), header.processes * sizeof(HotPCB));
+    sim.processes.resize(header.processes);
+    takeSection(cursor, sim.processes.data(), header.processes * sizeof(ProcessRecord));
+
+    // every live process has to fit the restored memory and code, or the run would index outside them
+    bool bad_process = false;
+    for (int slot = 0; slot < header.processes; slot++)
+    {
+        const HotPCB &pcb = sim.pcbTable[slot];
+        const ProcessRecord &record = sim.processes[slot];
+        if (record.completion_time >= 0)
+        {
+            continue; // terminated, its block went back to the allocator and only the reports read it
+        }
+
+        bad_process |= pcb.first_instruction < 0 || pcb.num_instructions < 0 || pcb.first_instruction > header.instructions - pcb.num_instructions ||
+                       pcb.program_counter < 0 || pcb.program_counter > pcb.num_instructions || pcb.compute_left < 0 || pcb.level >= header.levels;
+        bad_process |= pcb.max_memory_needed < 0 || record.memory_limit < 0 || record.main_memory_base < 0;
+        if (sim.config.paging)
+        {
+            int pages = (std::max(0, pcb.max_memory_needed) + sim.config.frame_size - 1) / sim.config.frame_size;
+            bad_process |= record.main_memory_base > header.backing_words - 10 || record.page_table_base < 0 ||
+                           record.page_table_base > header.pages - pages;
+        }
+        else
+        {
+            bad_process |= record.main_memory_base > header.max_memory - 10 || pcb.instruction_base < record.main_memory_base + 10 ||
+                           pcb.instruction_base > header.max_memory - std::max(pcb.max_memory_needed, record.memory_limit) ||
+                           record.data_base < pcb.instruction_base || record.data_base > pcb.instruction_base + record.memory_limit;
+        }
+    }
+
+    sim.processSlotAt.assign(header.max_memory, -1); // live processes by base, only the contiguous mode has them
+    for (int slot = 0; slot < header.processes && !sim.config.paging && !bad_process; slot++)
+    {
+        int base = sim.processes[slot].main_memory_base;
+        if (sim.processes[slot].completion_time < 0 && base >= 0 && base < header.max_memory)
+        {
+            sim.processSlotAt[base] = slot;
+        }
+    }
+
+    for (int i = 0; i < header.new_jobs; i++)
+    {
+        PCB job;
+        takeSection(cursor, &job, sizeof(job));
+        bad_process |= job.first_instruction < 0 || job.num_instructions < 0 || job.first_instruction > header.instructions - job.num_instructions ||
+                       job.max_memory_needed < 0;
+        sim.newJobQueue.push(job);
+    }
+
+    Scheduler &scheduler = sim.readyQueue;
+    initScheduler(scheduler, header.policy, header.levels, header.aging);
+    scheduler.sequence = header.ready_sequence;
+    bool bad_slot = false;
+    for (int i = 0; i < header.ready; i++)
+    {
+        SRTFEntry entry;
+        takeSection(cursor, &entry, sizeof(entry));
+        if (entry.slot < 0 || entry.slot >= header.processes || sim.processes[entry.slot].completion_time >= 0 ||
+            (header.policy >= POLICY_PRIORITY && (entry.remaining < 0 || entry.remaining >= header.levels)))
+        {
+            bad_slot = true;
+            continue;
+        }
+
+        scheduler.count++;
+        if (header.policy == POLICY_SRTF)
+        {
+            scheduler.shortest.push(entry);
+        }
+        else if (header.policy >= POLICY_PRIORITY)
+        {
+            LevelEntry queued;
+            queued.slot = entry.slot;
+            queued.since = entry.sequence;
+            scheduler.buckets[entry.remaining].push(queued);
+            scheduler.occupied |= 1u << entry.remaining;
+        }
+        else
+        {
+            scheduler.fifo.push(entry.slot);
+        }
+    }
+    sim.cores.clear();
+
+    for (int i = 0; i < header.IO_waiting; i++)
+    {
+        IOWaitEntry entry;
+        takeSection(cursor, &entry, sizeof(entry));
+        bad_slot |= entry.slot < 0 || entry.slot >= header.processes || sim.processes[entry.slot].completion_time >= 0;
+        bad_process |= entry.entered_time < 0 || entry.entered_time > header.CPU_clock || entry.completion_time < entry.entered_time;
+        sim.IOWaitingQueue.push(entry);
+    }
+
+    MemoryAllocator &memory = sim.memory;
+    initAllocator(memory, header.max_memory);
+    memory.free_by_address.clear();
+    memory.free_by_size.clear();
+    int free_end = 0; // blocks come in address order, none may overlap the one before it or run off the end
+    for (int i = 0; i < header.free_blocks; i++)
+    {
+        int block[2]; // address, size
+        takeSection(cursor, block, sizeof(block));
+        if (block[0] < free_end || block[1] <= 0 || block[1] > header.max_memory - block[0])
+        {
+            bad_process = true;
+            continue;
+        }
+        free_end = block[0] + block[1];
+        memory.free_by_address[block[0]] = block[1];
+        memory.free_by_size.insert(std::make_pair(block[1], block[0]));
+    }
+    memory.words_in_use = header.words_in_use;
+    memory.peak_words_in_use = header.peak_words_in_use;
+    memory.allocations = header.allocations;
+    memory.frees = header.frees;
+    memory.failed_admissions = header.failed_admissions;
+    memory.fragmentation_sum = header.fragmentation_sum;
+    memory.worst_fragmentation = header.worst_fragmentation;
+
+    takeSection(cursor, &sim.metrics, sizeof(QueueMetrics));
+
+    if (sim.config.paging)
+    {
+        PagedMemory &paged = sim.paged;
+        paged.frame_shift = 0;
+        while ((1 << paged.frame_shift) < sim.config.frame_size)
+        {
+            paged.frame_shift++;
+        }
+        paged.frame_mask = sim.config.frame_size - 1;
+        paged.frames = header.frames;
+        paged.tlb_mask = sim.config.tlb_entries - 1;
+
+        paged.backingStore.resize(header.backing_words);
+        takeSection(cursor, paged.backingStore.data(), header.backing_words * sizeof(int));
+        paged.pageTable.resize(header.pages);
+        takeSection(cursor, paged.pageTable.data(), header.pages * sizeof(int));
+        paged.tlb.resize(header.tlb_entries);
+        takeSection(cursor, paged.tlb.data(), header.tlb_entries * sizeof(TLBEntry));
+        paged.frame.resize(header.frames);
+        takeSection(cursor, paged.frame.data(), header.frames * sizeof(PageFrame));
+        paged.freeFrames.resize(header.free_frames);
+        takeSection(cursor, paged.freeFrames.data(), header.free_frames * sizeof(int));
+
+        paged.oldest = header.oldest;
+        paged.newest = header.newest;
+        paged.hand = header.hand;
+        paged.backing_used = header.backing_used;
+        paged.pages_used = header.pages_used;
+        paged.tlb_hits = header.tlb_hits;
+        paged.tlb_misses = header.tlb_misses;
+        paged.faults = header.faults;
+        paged.fault_ticks = header.fault_ticks;
+        paged.evictions = header.evictions;
+        paged.write_backs = header.write_backs;
+    }
+
+    unmapFile(file);
+
+    if (bad_slot)
+    {
+        std::cerr << "ERROR: " << path << " queues a process that is not in its process table" << "\n";
+        return false;
+    }
+    if (bad_process)
+    {
+        std::cerr << "ERROR: " << path << " is corrupt, a process, queued job, I/O wait or free block lies outside its memory or code" << "\n";
+        return false;
+    }
+    return true;
+} // END FUNCTION
+
+// copies the next section out of a checkpoint mapping and moves past it, the size was checked against the whole file
+void takeSection(const char *&cursor, void *data, size_t bytes)
+{
+    std::memcpy(data, cursor, bytes);
+    cursor += bytes;
+} // END FUNCTION
+
+
+// --stream: opens the input, file or stdin, and reads its header and the first job
+bool openJobStream(JobStream &stream, const std::string &path, Workload &workload)
+{
+    stream.in = path.empty() ? stdin : fopen(path.c_str(), "rb");
+    if (!stream.in)
+    {
+        std::cerr << "ERROR: could not open input file " << path << "\n";
+        return false;
+    }
+    stream.buffer.resize(1 << 16);
+    stream.position = stream.filled = 0;
+    stream.input_ended = false;
+    stream.last_arrival = 0;
+    stream.has_next = false;
+    stream.jobs_read = stream.live_jobs = stream.peak_live_jobs = 0;
+    stream.finished_cycles = 0;
+
+    if (!streamInt(stream, workload.max_memory) || !streamInt(stream, workload.context_switch_time) ||
+        !streamInt(stream, workload.CPU_allocated_time) || !streamInt(stream, workload.num_processes))
+    {
+        std::cerr << "ERROR: " << (path.empty() ? "stdin" : path) << " is missing the header line" << "\n";
+        return false;
+    }
+    stream.jobs_left = workload.num_processes > 0 ? workload.num_processes : -1;
+
+    return readStreamedJob(stream);
+} // END FUNCTION
+
+/*
+* Reads the next job ahead into stream.next, its decoded code into a free JobStream::jobs entry. has_next stays false
+* at the end of the input, or after a job that does not parse: that one is reported and the stream stops there.
+*/
+bool readStreamedJob(JobStream &stream)
+{
+    stream.has_next = false;
+    if (stream.jobs_left == 0)
+    {
+        return true;
+    }
+
+    PCB &process = stream.next;
+    int arrival_time;
+    if (!streamInt(stream, arrival_time))
+    {
+        if (stream.jobs_left > 0 || stream.position < stream.filled)
+        {
+            std::cerr << "ERROR: the job stream ended early or has a bad arrival time after " << stream.jobs_read << " jobs" << "\n";
+            return false;
+        }
+        return true; // read until the end, and this is it
+    }
+
+    int number_of_instructions;
+    if (!streamInt(stream, process.process_id) || !streamInt(stream, process.max_memory_needed) || !streamInt(stream, number_of_instructions) ||
+        number_of_instructions < 0)
+    {
+        std::cerr << "ERROR: the job stream ends in the middle of job " << stream.jobs_read + 1 << "\n";
+        return false;
+    }
+
+    process.state = 0;
+    process.program_counter = 0;
+    process.memory_limit = process.max_memory_needed;
+    process.CPU_cycles_used = 0;
+    process.register_value = 0;
+    process.num_instructions = number_of_instructions;
+    process.arrival_time = std::max(arrival_time, stream.last_arrival); // one out of order arrives with the one before it
+    stream.last_arrival = process.arrival_time;
+
+    if (stream.free_jobs.empty())
+    {
+        stream.free_jobs.push_back(stream.jobs.size());
+        stream.jobs.push_back(StreamedJob());
+    }
+    process.first_instruction = stream.free_jobs.back();
+    stream.free_jobs.pop_back();
+
+    StreamedJob &job = stream.jobs[process.first_instruction];
+    job.code.resize(number_of_instructions);
+    for (int j = 0; j < number_of_instructions; j++)
+    {
+        Instruction &current_instruction = job.code[j];
+        current_instruction.operand_1 = 0;
+        current_instruction.operand_2 = 0;
+        current_instruction.data_offset = 0;
+
+        bool ok = streamInt(stream, current_instruction.op_code);
+        if (current_instruction.op_code == 1 || current_instruction.op_code == 3) // compute and store: 2 parameters
+        {
+            ok = ok && streamInt(stream, current_instruction.operand_1) && streamInt(stream, current_instruction.operand_2);
+        }
+        else if (current_instruction.op_code == 2 || current_instruction.op_code == 4) // print and load: 1 parameter
+        {
+            ok = ok && streamInt(stream, current_instruction.operand_1);
+        }
+
+        if (!ok)
+        {
+            std::cerr << "ERROR: the job stream ends in the middle of process " << process.process_id << "\n";
+            stream.free_jobs.push_back(process.first_instruction);
+            return false;
+        }
+    }
+
+    // same decoding as a whole input gets, on the job's own code: operand offsets, then its burst estimates
+    int job_index = process.first_instruction;
+    process.first_instruction = 0;
+    finishDecodingJob(process, job.code);
+    process.first_instruction = job_index;
+    job.remainingBurst.resize(number_of_instructions);
+    computeJobBurst(job.code.data(), number_of_instructions, job.remainingBurst.data());
+
+    stream.jobs_read++;
+    stream.live_jobs++;
+    stream.peak_live_jobs = std::max(stream.peak_live_jobs, stream.live_jobs);
+    if (stream.jobs_left > 0)
+    {
+        stream.jobs_left--;
+    }
+    stream.has_next = true;
+    return true;
+} // END FUNCTION
+
+// next integer of the stream: a token cut off by the end of the buffer is moved to its front and the rest read in after it
+bool streamInt(JobStream &stream, int &value)
+{
+    while (true)
+    {
+        const char *data = stream.buffer.data();
+        while (stream.position < stream.filled && (data[stream.position] == ' ' || data[stream.position] == '\n' ||
+               data[stream.position] == '\r' || data[stream.position] == '\t'))
+        {
+            stream.position++;
+        }
+
+        size_t token_end = stream.position;
+        while (token_end < stream.filled && data[token_end] != ' ' && data[token_end] != '\n' && data[token_end] != '\r' && data[token_end] != '\t')
+        {
+            token_end++;
+        }
+
+        if (token_end < stream.filled || (stream.input_ended && token_end > stream.position))
+        {
+            const char *cursor = data + stream.position;
+            bool ok = scanInt(cursor, data + token_end, value) && cursor == data + token_end;
+            stream.position = token_end;
+            return ok;
+        }
+        if (stream.input_ended)
+        {
+            return false;
+        }
+
+        size_t kept = stream.filled - stream.position;
+        std::memmove(stream.buffer.data(), data + stream.position, kept);
+        stream.position = 0;
+        stream.filled = kept;
+        if (kept == stream.buffer.size())
+        {
+            stream.buffer.resize(2 * stream.buffer.size()); // one token bigger than the whole buffer, not a number we can use anyway
+        }
+
+        size_t got = fread(stream.buffer.data() + stream.filled, 1, stream.buffer.size() - stream.filled, stream.in);
+        stream.filled += got;
+        stream.input_ended = got == 0;
+    }
+} // END FUNCTION
+
+/*
+* Parses a job file in place out of a mapping of it. The scanner treats every kind of whitespace the same, so a process
+* that wraps onto several lines parses exactly like one on a single line, and nothing is copied into strings or streams.
+* Produces the same jobs and instructionStream as the std::cin path in main.
+*/
+bool parseJobFile(const std::string &path, Workload &workload)
+{
+    MappedFile file;
+    if (!mapFile(path, file))
+    {
+        std::cerr << "ERROR: could not open input file " << path << "\n";
+        return false;
+    }
+
+    const char *cursor = file.data;
+    const char *end = file.data + file.size;
+
+    if (!scanInt(cursor, end, workload.max_memory) || !scanInt(cursor, end, workload.context_switch_time) ||
+        !scanInt(cursor, end, workload.CPU_allocated_time) || !scanInt(cursor, end, workload.num_processes))
+    {
+        std::cerr << "ERROR: " << path << " is missing the header line" << "\n";
+        unmapFile(file);
+        return false;
+    }
+
+    const char *first_job = cursor;
+
+    // every instruction takes at least two numbers and a number plus its separator is at least two bytes,
+    // a quarter of that bound is plenty for real traces and saves regrowing the stream from empty
+    workload.instructionStream.reserve(workload.instructionStream.size() + file.size / 16);
+    workload.jobs.reserve(workload.num_processes);
+
+    bool ok = true;
+    for (int i = 0; i < workload.num_processes && ok; i++)
+    {
+        PCB process;
+        int number_of_instructions;
+        if (!scanInt(cursor, end, process.process_id) || !scanInt(cursor, end, process.max_memory_needed) ||
+            !scanInt(cursor, end, number_of_instructions))
+        {
+            ok = false;
+            break;
+        }
+
+        process.state = 0;
+        process.program_counter = 0;
+        process.memory_limit = process.max_memory_needed;
+        process.CPU_cycles_used = 0;
+        process.register_value = 0;
+        process.first_instruction = workload.instructionStream.size();
+        process.num_instructions = number_of_instructions;
+        process.arrival_time = 0;
+
+        for (int j = 0; j < number_of_instructions; j++)
+        {
+            Instruction current_instruction;
+            current_instruction.operand_1 = 0;
+            current_instruction.operand_2 = 0;
+            current_instruction.data_offset = 0; // filled in by finishDecodingJob
+
+            if (!scanInt(cursor, end, current_instruction.op_code))
+            {
+                ok = false;
+                break;
+            }
+
+            if (current_instruction.op_code == 1 || current_instruction.op_code == 3) // compute and store: 2 parameters
+            {
+                ok = scanInt(cursor, end, current_instruction.operand_1) && scanInt(cursor, end, current_instruction.operand_2);
+            }
+            else if (current_instruction.op_code == 2 || current_instruction.op_code == 4) // print and load: 1 parameter
+            {
+                ok = scanInt(cursor, end, current_instruction.operand_1);
+            }
+
+            workload.instructionStream.push_back(current_instruction);
+            if (!ok)
+            {
+                break;
+            }
+        }
+
+        if (ok)
+        {
+            finishDecodingJob(process, workload.instructionStream);
+        }
+        workload.jobs.push_back(process);
+    }
+
+    // a --generate --arrivals trace read without --stream: it either runs out in the middle of a job or has numbers left over
+    const char *rest = cursor;
+    int leftover;
+    if ((!ok || scanInt(rest, end, leftover)) && parsesWithArrivals(first_job, end, workload.num_processes))
+    {
+        std::cerr << "ERROR: " << path << " has an arrival time in front of every job, it is a --stream input (run it with --stream)" << "\n";
+        unmapFile(file);
+        return false;
+    }
+    unmapFile(file);
+
+    if (!ok)
+    {
+        std::cerr << "ERROR: " << path << " ends in the middle of process " << workload.jobs.size() << "\n";
+        return false;
+    }
+    return true;
+} // END FUNCTION
+
+// whether the jobs after the header read cleanly, to the last number, as --stream jobs: arrival time first
+bool parsesWithArrivals(const char *cursor, const char *end, int num_processes)
+{
+    int value;
+    for (int i = 0; i < num_processes; i++)
+    {
+        int number_of_instructions;
+        if (!scanInt(cursor, end, value) || !scanInt(cursor, end, value) || !scanInt(cursor, end, value) ||
+            !scanInt(cursor, end, number_of_instructions) || number_of_instructions < 0)
+        {
+            return false;
+        }
+        for (int j = 0; j < number_of_instructions; j++)
+        {
+            int op_code;
+            if (!scanInt(cursor, end, op_code))
+            {
+                return false;
+            }
+            int operands = (op_code == 1 || op_code == 3) ? 2 : (op_code == 2 || op_code == 4) ? 1 : 0;
+            for (int k = 0; k < operands; k++)
+            {
+                if (!scanInt(cursor, end, value))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return !scanInt(cursor, end, value); // nothing left over
+} // END FUNCTION
+
+bool mapFile(const std::string &path, MappedFile &file)
+{
+    file.data = nullptr;
+    file.size = 0;
+
+#ifdef NO_MMAP
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+    {
+        return false;
+    }
+    file.buffer.resize((size_t)in.tellg());
+    in.seekg(0);
+    in.read(file.buffer.data(), file.buffer.size());
+    file.data = file.buffer.data();
+    file.size = file.buffer.size();
+    return true;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    file.size = info.st_size;
+    if (file.size == 0)
+    {
+        close(fd);
+        file.data = "";
+        return true;
+    }
+
+    void *mapping = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    madvise(mapping, file.size, MADV_SEQUENTIAL); // we read it front to back once
+    file.data = (const char *)mapping;
+    return true;
+#endif
+} // END FUNCTION
+
+void unmapFile(MappedFile &file)
+{
+#ifndef NO_MMAP
+    if (file.size > 0)
+    {
+        munmap((void *)file.data, file.size);
+    }
+#endif
+    file.buffer.clear();
+    file.data = nullptr;
+    file.size = 0;
+} // END FUNCTION
+
+// pulls the next integer out of [cursor, end), skipping whitespace and line breaks in front of it
+bool scanInt(const char *&cursor, const char *end, int &value)
+{
+    while (cursor < end && (*cursor == ' ' || *cursor == '\n' || *cursor == '\r' || *cursor == '\t'))
+    {
+        cursor++;
+    }
+
+    std::from_chars_result result = std::from_chars(cursor, end, value);
+    if (result.ec != std::errc())
+    {
+        return false;
+    }
+
+    cursor = result.ptr;
+    return true;
+} // END FUNCTION
+
+/*
+* Fills in where each of a freshly parsed job's instructions keeps its operands in the data segment, and applies the
+* rule the CPU has always used for operands that would fall past the end of the data segment: they read as -1.
+* Done once per job at parse time so loading and executing only ever read the stream.
+*/
+void finishDecodingJob(const PCB &process, std::vector<Instruction> &instructionStream)
+{
+    int data_size = process.memory_limit - process.num_instructions; // size of data-segment
+    int memory_index = 0;
+
+    for (int i = 0; i < process.num_instructions; i++)
+    {
+        Instruction &current_instruction = instructionStream[process.first_instruction + i];
+        current_instruction.data_offset = memory_index;
+
+        if (current_instruction.op_code == 1 || current_instruction.op_code == 3) // compute and store: 2 parameters
+        {
+            if (memory_index + 1 >= data_size)
+            {
+                current_instruction.operand_1 = -1;
+                current_instruction.operand_2 = -1;
+            }
+            memory_index += 2;
+        }
+        else if (current_instruction.op_code == 2 || current_instruction.op_code == 4) // print and load: 1 parameter
+        {
+            if (memory_index >= data_size)
+            {
+                current_instruction.operand_1 = -1;
+            }
+            memory_index += 1;
+        }
+    }
+} // END FUNCTION
+
+/*
+* remainingBurst[i] is the CPU ticks from instruction i to the end of its job: compute cycles plus one per store and
+* load, prints are I/O. A suffix sum per job, once per workload, so a scheduler's estimate is a single lookup.
+*/
+void computeBurstEstimates(Workload &workload)
+{
+    const std::vector<Instruction> &instructionStream = workload.instructionStream;
+    workload.remainingBurst.assign(instructionStream.size(), 0);
+
+    std::vector<std::pair<int, int>> ranges; // (first_instruction, num_instructions) of every job
+    for (size_t i = 0; i < workload.jobs.size(); i++)
+    {
+        ranges.push_back(std::make_pair(workload.jobs[i].first_instruction, workload.jobs[i].num_instructions));
+    }
+    for (size_t i = 0; i < workload.image_processes.size(); i++)
+    {
+        ranges.push_back(std::make_pair(workload.image_processes[i].first_instruction, workload.image_processes[i].num_instructions));
+    }
+
+    for (size_t job = 0; job < ranges.size(); job++)
+    {
+        computeJobBurst(instructionStream.data() + ranges[job].first, ranges[job].second, workload.remainingBurst.data() + ranges[job].first);
+    }
+} // END FUNCTION
+
+// the suffix sum for one job's code
+void computeJobBurst(const Instruction *code, int num_instructions, int *remaining)
+{
+    int burst = 0;
+    for (int i = num_instructions - 1; i >= 0; i--)
+    {
+        if (code[i].op_code == 1)
+        {
+            burst += std::max(0, code[i].operand_2);
+        }
+        else if (code[i].op_code == 3 || code[i].op_code == 4)
+        {
+            burst += 1;
+        }
+        remaining[i] = burst;
+    }
+} // END FUNCTION
+
+// sets up a fresh machine for the workload with the given scheduler parameters and loads its jobs (Step 2)
+void initSimulation(Simulation &sim, const Workload &workload, const RunConfig &config, int context_switch_time, int CPU_allocated_time)
+{
+    sim.workload = &workload;
+    sim.stream = nullptr;
+    sim.next_checkpoint = -1;
+    sim.CPU_clock = 0;
+    sim.context_switch_time = context_switch_time;
+    sim.CPU_allocated_time = CPU_allocated_time;
+    sim.log = nullptr; // quiet until the caller attaches an event log
+    sim.log_level = LOG_OFF;
+    sim.config = config;
+    sim.profile = nullptr; // likewise for a Profile
+    sim.IO_sequence = 0;
+    sim.instructions_executed = 0;
+
+    sim.mainMemory.assign(workload.max_memory, -1); // initialize main memory with -1 with size of maxMemory
+    sim.processSlotAt.assign(workload.max_memory, -1);
+    sim.pcbTable.clear();
+    sim.pcbTable.reserve(workload.jobs.size() + workload.image_processes.size()); // nothing to go on for --stream, it grows to the live jobs
+    sim.processes.clear();
+    sim.processes.reserve(workload.jobs.size() + workload.image_processes.size());
+    sim.rejected_jobs = 0;
+    initScheduler(sim.readyQueue, sim.config.policy, sim.config.levels, sim.config.aging > 0 ? sim.config.aging : 10 * CPU_allocated_time);
+    sim.cores.assign(sim.config.cpus, Core());
+    for (size_t c = 0; c < sim.cores.size(); c++)
+    {
+        Core &core = sim.cores[c];
+        core.clock = 0;
+        core.running = -1;
+        core.exit_reason = EXIT_TERMINATED;
+        core.busy_ticks = core.switch_ticks = core.idle_ticks = 0;
+        core.dispatches = core.steals = core.migrations = 0;
+    }
+    clearHistogram(sim.metrics.new_job_wait);
+    clearHistogram(sim.metrics.ready_wait);
+    clearHistogram(sim.metrics.IO_wait);
+    clearHistogram(sim.metrics.response);
+    clearHistogram(sim.metrics.turnaround);
+    initAllocator(sim.memory, workload.max_memory);
+    if (sim.config.paging)
+    {
+        initPagedMemory(sim, workload);
+    }
+
+    if (!workload.image_processes.empty())
+    {
+        placeMemoryImage(sim);
+        return;
+    }
+
+    for (size_t i = 0; i < workload.jobs.size(); i++)
+    {
+        sim.newJobQueue.push(workload.jobs[i]);
+    }
+    loadJobsToMemory(sim);
+} // END FUNCTION
+
+// saves what loadJobsToMemory produced in the binary workload format
+bool writeWorkloadImage(const std::string &path, Simulation &sim)
+{
+    const std::vector<int> &mainMemory = sim.mainMemory;
+    const std::vector<Instruction> &instructionStream = sim.workload->instructionStream;
+    std::queue<PCB> newJobQueue = sim.newJobQueue; // walk a copy, the simulation's own queue is left alone
+
+    // straight after loading the processes sit back to back in admission order, which is the round robin readyQueue
+    // order, so walking memory by address gives the same order whatever policy this simulation was set up with
+    std::vector<int> loaded;
+    loaded.reserve(sim.readyQueue.count);
+    for (size_t base = 0; base < sim.processSlotAt.size(); base++)
+    {
+        if (sim.processSlotAt[base] >= 0)
+        {
+            loaded.push_back(base);
+        }
+    }
+
+    std::vector<WorkloadProcess> processes;
+    processes.reserve(loaded.size() + newJobQueue.size());
+
+    int image_words = 0; // everything past the end of the last process is still -1, no need to store it
+    for (size_t i = 0; i < loaded.size(); i++)
+    {
+        int base = loaded[i];
+
+        WorkloadProcess process;
+        process.main_memory_base = base;
+        process.first_instruction = sim.pcbTable[sim.processSlotAt[base]].first_instruction;
+        process.process_id = mainMemory[base];
+        process.max_memory_needed = mainMemory[base + 8];
+        process.num_instructions = mainMemory[base + 4] - mainMemory[base + 3]; // data_base - instruction_base
+        processes.push_back(process);
+
+        int process_end = mainMemory[base + 3] + mainMemory[base + 8]; // instruction_base + max_memory_needed
+        image_words = std::max(image_words, std::min(process_end, (int)mainMemory.size()));
+    }
+
+    while (!newJobQueue.empty())
+    {
+        const PCB &job = newJobQueue.front();
+
+        WorkloadProcess process;
+        process.main_memory_base = -1;
+        process.first_instruction = job.first_instruction;
+        process.process_id = job.process_id;
+        process.max_memory_needed = job.max_memory_needed;
+        process.num_instructions = job.num_instructions;
+        processes.push_back(process);
+
+        newJobQueue.pop();
+    }
+
+    WorkloadHeader header;
+    header.magic = WORKLOAD_MAGIC;
+    header.version = WORKLOAD_VERSION;
+    header.max_memory = sim.workload->max_memory;
+    header.context_switch_time = sim.context_switch_time;
+    header.CPU_allocated_time = sim.CPU_allocated_time;
+    header.num_processes = processes.size();
+    header.num_instructions = instructionStream.size();
+    header.image_words = image_words;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "ERROR: could not create binary workload " << path << "\n";
+        return false;
+    }
+
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)processes.data(), processes.size() * sizeof(WorkloadProcess));
+    out.write((const char *)instructionStream.data(), instructionStream.size() * sizeof(Instruction));
+    out.write((const char *)mainMemory.data(), (size_t)image_words * sizeof(int));
+
+    if (!out)
+    {
+        std::cerr << "ERROR: failed writing binary workload " << path << "\n";
+        return false;
+    }
+
+    std::cout << "wrote " << processes.size() << " processes (" << sim.newJobQueue.size() << " not yet loaded), " << instructionStream.size()
+              << " instructions and " << image_words << " memory words to " << path << "\n";
+    return true;
+} // END FUNCTION
+
+/*
+* Runs one quiet simulation per (context switch time, CPU allocated time) pair on a pool of worker threads. The workload
+* was parsed once and is only read, every simulation gets its own mainMemory, queues and clock, so the workers never
+* touch each other's state. Workers pull the next pair off a shared counter until there are none left.
+*/
+void runSweep(const Workload &workload, const RunConfig &config, const std::vector<int> &switch_times, const std::vector<int> &allocated_times, unsigned int threads)
+{
+    std::vector<std::pair<int, int>> runs;
+    for (size_t i = 0; i < switch_times.size(); i++)
+    {
+        for (size_t j = 0; j < allocated_times.size(); j++)
+        {
+            runs.push_back(std::make_pair(switch_times[i], allocated_times[j]));
+        }
+    }
+
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min<unsigned int>(threads, runs.size());
+
+    std::vector<SweepResult> results(runs.size());
+    std::atomic<size_t> next_run(0);
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&]()
+        {
+            for (size_t run = next_run++; run < runs.size(); run = next_run++)
+            {
+                Simulation sim;
+                initSimulation(sim, workload, config, runs[run].first, runs[run].second);
+                runSimulation(sim);
+                results[run] = summarizeSimulation(sim);
+            }
+        });
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+
+    std::cout << "sweep of " << runs.size() << " simulations over " << workload.num_processes << " processes on " << threads << " threads, "
+              << scheduler_names[config.policy] << " scheduler" << "\n";
+    std::cout << std::setw(8) << "cs" << std::setw(8) << "alloc" << std::setw(12) << "clock"
+              << std::setw(16) << "jobs/1k ticks" << std::setw(16) << "avg turnaround" << std::setw(14) << "avg waiting" << "\n";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const SweepResult &result = results[i];
+        double throughput = result.final_clock > 0 ? 1000.0 * result.processes_finished / result.final_clock : 0;
+
+        std::cout << std::setw(8) << result.context_switch_time << std::setw(8) << result.CPU_allocated_time
+                  << std::setw(12) << result.final_clock << std::fixed << std::setprecision(3)
+                  << std::setw(16) << throughput << std::setw(16) << result.average_turnaround
+                  << std::setw(14) << result.average_waiting << "\n";
+    }
+} // END FUNCTION
+
+// turnaround is completion time (every job arrives at 0), waiting is time spent sitting in the readyQueue
+SweepResult summarizeSimulation(const Simulation &sim)
+{
+    SweepResult result;
+    result.context_switch_time = sim.context_switch_time;
+    result.CPU_allocated_time = sim.CPU_allocated_time;
+    result.final_clock = sim.CPU_clock;
+    result.processes_finished = 0;
+
+    long long total_turnaround = 0;
+    long long total_waiting = 0;
+    for (size_t i = 0; i < sim.processes.size(); i++)
+    {
+        if (sim.processes[i].completion_time < 0)
+        {
+            continue;
+        }
+        result.processes_finished++;
+        total_turnaround += sim.processes[i].completion_time;
+        total_waiting += sim.pcbTable[i].waiting_time;
+    }
+
+    result.average_turnaround = result.processes_finished > 0 ? (double)total_turnaround / result.processes_finished : 0;
+    result.average_waiting = result.processes_finished > 0 ? (double)total_waiting / result.processes_finished : 0;
+    return result;
+} // END FUNCTION
+
+/*
+* --bench: parse was timed by main, load (initSimulation) and execute (runSimulation) are timed here, quietly, and the
+* fastest of the repeats is reported for each so a noisy run does not hide or fake a regression.
+*/
+void runBenchmark(const Workload &workload, const RunConfig &config, double parse_seconds, int repeats)
+{
+    BenchmarkResult best;
+    best.parse_seconds = parse_seconds;
+    best.load_seconds = std::numeric_limits<double>::max();
+    best.execute_seconds = std::numeric_limits<double>::max();
+    best.instructions = 0;
+    best.processes_finished = 0;
+
+    for (int run = 0; run < repeats; run++)
+    {
+        Simulation sim;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        initSimulation(sim, workload, config, workload.context_switch_time, workload.CPU_allocated_time);
+        std::chrono::steady_clock::time_point loaded = std::chrono::steady_clock::now();
+        runSimulation(sim);
+        std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+
+        best.load_seconds = std::min(best.load_seconds, std::chrono::duration<double>(loaded - start).count());
+        best.execute_seconds = std::min(best.execute_seconds, std::chrono::duration<double>(finished - loaded).count());
+        best.instructions = sim.instructions_executed;
+        best.processes_finished = summarizeSimulation(sim).processes_finished;
+    }
+
+    double total_seconds = best.parse_seconds + best.load_seconds + best.execute_seconds;
+
+    std::cout << "benchmark: " << workload.num_processes << " processes, " << workload.instructionStream.size() << " instructions, "
+              << (config.dispatch == DISPATCH_THREADED ? "threaded" : "branch") << " dispatch, " << scheduler_names[config.policy] << " scheduler, best of " << repeats << "\n";
+    std::cout << std::fixed << std::setprecision(6);
+    std::cout << std::setw(10) << "parse" << std::setw(14) << best.parse_seconds << " s" << "\n";
+    std::cout << std::setw(10) << "load" << std::setw(14) << best.load_seconds << " s" << "\n";
+    std::cout << std::setw(10) << "execute" << std::setw(14) << best.execute_seconds << " s" << "\n";
+    std::cout << std::setw(10) << "total" << std::setw(14) << total_seconds << " s" << "\n";
+    std::cout << std::setprecision(0);
+    std::cout << "simulated instructions: " << best.instructions << ", instructions/sec: "
+              << (best.execute_seconds > 0 ? best.instructions / best.execute_seconds : 0) << "\n";
+    std::cout << "jobs finished: " << best.processes_finished << ", jobs/sec: "
+              << (total_seconds > 0 ? best.processes_finished / total_seconds : 0) << "\n";
+    std::cout << "peak RSS: " << peakResidentKB() << " KB" << "\n";
+} // END FUNCTION
+
+// high water mark of the process's resident set, 0 where getrusage is not available
+long peakResidentKB()
+{
+#if defined(_WIN32)
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;        // kilobytes on Linux
+#endif
+#endif
+} // END FUNCTION
+
+
+void show_PCB(PCB process, const std::vector<Instruction> &instructionStream) 
+{
+    std::cout << "PROCESS ["<<process.process_id<<"] " << "maxMemoryNeeded: " << process.max_memory_needed << std::endl;
+    std::cout << "num-instructions: " << process.num_instructions << std::endl;
+
+    for (int i = 0; i < process.num_instructions; i++) 
+    {
+        const Instruction &current_instruction = instructionStream[process.first_instruction + i];
+
+        if (current_instruction.op_code == 1) // compute: 2 parameters
+        { 
+            std::cout << "instruction: " << current_instruction.op_code << " iter: " << current_instruction.operand_1 << " cycles: " << current_instruction.operand_2 << std::endl;
+        }
+        if (current_instruction.op_code == 2) // print: 1 parameter
+        {
+            std::cout << "instruction: " << current_instruction.op_code << " cycles: " << current_instruction.operand_1 << std::endl;
+        }
+        if (current_instruction.op_code == 3) // write: 2 parameters 
+        {
+            std::cout << "instruction: " << current_instruction.op_code << " value: " << current_instruction.operand_1 << " address: " << current_instruction.operand_2 << std::endl;
+        }
+        if (current_instruction.op_code == 4) // load: 1 parameter
+        {
+            std::cout << "instruction: " << current_instruction.op_code << " address: " << current_instruction.operand_1 << std::endl;
+        }
+        
+    }// END FOR LOOP
+} //  END show_PCB
+
+
+/*
+* Copies a --binary workload's memory image into place and readies the processes in it, this replaces loadJobsToMemory
+* for them. Jobs that were still waiting for memory when the file was written go back on the newJobQueue.
+*/
+void placeMemoryImage(Simulation &sim)
+{
+    const Workload &workload = *sim.workload;
+    std::memcpy(sim.mainMemory.data(), workload.memory_image.data(), workload.memory_image.size() * sizeof(int));
+
+    for (size_t i = 0; i < workload.image_processes.size(); i++)
+    {
+        const WorkloadProcess &process = workload.image_processes[i];
+
+        if (process.main_memory_base < 0)
+        {
+            PCB job;
+            job.process_id = process.process_id;
+            job.state = STATE_NEW;
+            job.program_counter = 0;
+            job.memory_limit = process.max_memory_needed;
+            job.CPU_cycles_used = 0;
+            job.register_value = 0;
+            job.max_memory_needed = process.max_memory_needed;
+            job.first_instruction = process.first_instruction;
+            job.num_instructions = process.num_instructions;
+            job.arrival_time = 0;
+            sim.newJobQueue.push(job);
+            continue;
+        }
+
+        reserveBlock(sim.memory, process.main_memory_base, 10 + process.max_memory_needed);
+
+        int slot = addProcess(sim, process.main_memory_base, process.first_instruction, 0);
+        recordLatency(sim.metrics.new_job_wait, 0);
+        pushReady(sim, slot);
+    }
+} // END FUNCTION
+
+void initAllocator(MemoryAllocator &memory, int capacity)
+{
+    memory.free_by_address.clear();
+    memory.free_by_size.clear();
+    memory.capacity = capacity;
+    memory.words_in_use = 0;
+    memory.peak_words_in_use = 0;
+    memory.allocations = 0;
+    memory.frees = 0;
+    memory.failed_admissions = 0;
+    memory.fragmentation_sum = 0;
+    memory.worst_fragmentation = 0;
+
+    if (capacity > 0)
+    {
+        memory.free_by_address[0] = capacity;
+        memory.free_by_size.insert(std::make_pair(capacity, 0));
+    }
+} // END FUNCTION
+
+// best fit: the smallest free block that is big enough, carved from its low end. false if no block is big enough
+bool allocateBlock(MemoryAllocator &memory, int size, int &address)
+{
+    std::set<std::pair<int, int>>::iterator best = memory.free_by_size.lower_bound(std::make_pair(size, -1));
+    if (best == memory.free_by_size.end())
+    {
+        return false;
+    }
+
+    int block_size = best->first;
+    address = best->second;
+
+    memory.free_by_size.erase(best);
+    memory.free_by_address.erase(address);
+
+    if (block_size > size) // give back what we did not use
+    {
+        memory.free_by_address[address + size] = block_size - size;
+        memory.free_by_size.insert(std::make_pair(block_size - size, address + size));
+    }
+
+    memory.words_in_use += size;
+    memory.peak_words_in_use = std::max(memory.peak_words_in_use, memory.words_in_use);
+    memory.allocations++;
+    return true;
+} // END FUNCTION
+
+// marks a specific range as allocated, for a memory image whose layout was decided when it was written
+void reserveBlock(MemoryAllocator &memory, int address, int size)
+{
+    std::map<int, int>::iterator block = memory.free_by_address.upper_bound(address);
+    if (block == memory.free_by_address.begin())
+    {
+        return; // already allocated
+    }
+    --block;
+
+    int block_start = block->first;
+    int block_size = block->second;
+    if (address + size > block_start + block_size)
+    {
+        return; // overlaps something already allocated, the image is inconsistent so leave it be
+    }
+
+    memory.free_by_size.erase(std::make_pair(block_size, block_start));
+    memory.free_by_address.erase(block);
+
+    if (address > block_start) // piece in front of the reservation
+    {
+        memory.free_by_address[block_start] = address - block_start;
+        memory.free_by_size.insert(std::make_pair(address - block_start, block_start));
+    }
+    if (address + size < block_start + block_size) // piece behind it
+    {
+        int tail = address + size;
+        memory.free_by_address[tail] = block_start + block_size - tail;
+        memory.free_by_size.insert(std::make_pair(block_start + block_size - tail, tail));
+    }
+
+    memory.words_in_use += size;
+    memory.peak_words_in_use = std::max(memory.peak_words_in_use, memory.words_in_use);
+    memory.allocations++;
+} // END FUNCTION
+
+// returns a block to the free sets, merging it with a free neighbour on either side
+void freeBlock(MemoryAllocator &memory, int address, int size)
+{
+    int start = address;
+    int end = address + size;
+
+    std::map<int, int>::iterator next = memory.free_by_address.lower_bound(address);
+    if (next != memory.free_by_address.end() && next->first == end) // free block right behind us
+    {
+        end += next->second;
+        memory.free_by_size.erase(std::make_pair(next->second, next->first));
+        next = memory.free_by_address.erase(next);
+    }
+
+    if (next != memory.free_by_address.begin())
+    {
+        std::map<int, int>::iterator previous = std::prev(next);
+        if (previous->first + previous->second == start) // free block right in front of us
+        {
+            start = previous->first;
+            memory.free_by_size.erase(std::make_pair(previous->second, previous->first));
+            memory.free_by_address.erase(previous);
+        }
+    }
+
+    memory.free_by_address[start] = end - start;
+    memory.free_by_size.insert(std::make_pair(end - start, start));
+
+    memory.words_in_use -= size;
+    memory.frees++;
+} // END FUNCTION
+
+// 1 - largest free block / total free words: 0 when all the free memory is one block, close to 1 when it is in crumbs
+double externalFragmentation(const MemoryAllocator &memory)
+{
+    int total_free = memory.capacity - memory.words_in_use;
+    if (total_free <= 0 || memory.free_by_size.empty())
+    {
+        return 0;
+    }
+    return 1.0 - (double)memory.free_by_size.rbegin()->first / total_free;
+} // END FUNCTION
+
+// sizes everything --paging needs for the whole run: the backing store and page table for every job, the frames, the TLB
+void initPagedMemory(Simulation &sim, const Workload &workload)
+{
+    PagedMemory &paged = sim.paged;
+
+    paged.frame_shift = 0;
+    while ((1 << paged.frame_shift) < sim.config.frame_size)
+    {
+        paged.frame_shift++;
+    }
+    paged.frame_mask = sim.config.frame_size - 1;
+    paged.frames = workload.max_memory >> paged.frame_shift;
+    paged.tlb_mask = sim.config.tlb_entries - 1;
+
+    size_t backing_words = 0;
+    size_t pages = 0;
+    for (size_t i = 0; i < workload.jobs.size(); i++)
+    {
+        int max_memory_needed = std::max(0, workload.jobs[i].max_memory_needed);
+        backing_words += 10 + max_memory_needed;
+        pages += (max_memory_needed + paged.frame_mask) >> paged.frame_shift;
+    }
+    paged.backingStore.assign(backing_words, -1);
+    paged.pageTable.assign(pages, -1);
+
+    TLBEntry empty_entry;
+    empty_entry.page = -1;
+    empty_entry.frame = -1;
+    paged.tlb.assign(sim.config.tlb_entries, empty_entry);
+
+    PageFrame free_frame;
+    free_frame.page = -1;
+    free_frame.backing_address = 0;
+    free_frame.words = 0;
+    free_frame.dirty = false;
+    free_frame.referenced = false;
+    free_frame.uses = 0;
+    free_frame.older = free_frame.newer = -1;
+    paged.frame.assign(paged.frames, free_frame);
+
+    paged.freeFrames.clear();
+    for (int frame = paged.frames - 1; frame >= 0; frame--) // frame 0 is handed out first
+    {
+        paged.freeFrames.push_back(frame);
+    }
+    paged.oldest = paged.newest = -1;
+    paged.hand = 0;
+    paged.backing_used = 0;
+    paged.pages_used = 0;
+    paged.tlb_hits = paged.tlb_misses = 0;
+    paged.faults = paged.fault_ticks = 0;
+    paged.evictions = paged.write_backs = 0;
+} // END FUNCTION
+
+
+/*
+* Admits jobs from the front of the newJobQueue for as long as the next one fits in a free block. A job that does not
+* fit stays at the front until a terminating process frees enough memory, so this is called again on every termination.
+* Jobs bigger than all of main memory could never run, those are reported and dropped. With --paging every job goes
+* straight into the backing store instead and nothing waits.
+*/
+void loadJobsToMemory(Simulation &sim) 
+{
+    std::vector<int> &image = sim.config.paging ? sim.paged.backingStore : sim.mainMemory; // where the PCB and logical memory are written
+
+    while (!sim.newJobQueue.empty()) 
+    {
+        PCB current_process = sim.newJobQueue.front();  // access front element
+        int block_size = 10 + current_process.max_memory_needed; // PCB words + logical memory
+
+        if (block_size > sim.memory.capacity && !sim.config.paging)
+        {
+            std::cerr << "ERROR: Process " << current_process.process_id << " needs " << block_size << " words but main memory only has "
+                      << sim.memory.capacity << ", it can never be loaded" << "\n";
+            if (sim.stream)
+            {
+                releaseStreamedJob(sim, current_process.first_instruction, -1);
+            }
+            sim.newJobQueue.pop();
+            sim.rejected_jobs++;
+            continue;
+        }
+
+        int current_address;
+        if (sim.config.paging)
+        {
+            current_address = sim.paged.backing_used; // the backing store has room for every job, only the frames are scarce
+            sim.paged.backing_used += block_size;
+        }
+        else if (!allocateBlock(sim.memory, block_size, current_address))
+        {
+            double fragmentation = externalFragmentation(sim.memory);
+            sim.memory.failed_admissions++;
+            sim.memory.fragmentation_sum += fragmentation;
+            sim.memory.worst_fragmentation = std::max(sim.memory.worst_fragmentation, fragmentation);
+            break; // wait for a termination to free something
+        }
+        sim.newJobQueue.pop();  
+
+        if (sim.memory.frees > 0)
+        {
+            std::fill(image.begin() + current_address, image.begin() + current_address + block_size, -1); // reused memory, clear what the last owner left
+        }
+
+        current_process.main_memory_base = current_address;
+        current_process.instruction_base = current_address + 10; 
+        current_process.data_base = current_process.instruction_base + current_process.num_instructions;
+
+        image[current_address] = current_process.process_id;
+        image[current_address + 1] = 1;
+        image[current_address + 2] = current_process.program_counter;
+        image[current_address + 3] = current_process.instruction_base;
+        image[current_address + 4] = current_process.data_base;
+        image[current_address + 5] = current_process.memory_limit;
+        image[current_address + 6] = current_process.CPU_cycles_used;
+        image[current_address + 7] = current_process.register_value;
+        image[current_address + 8] = current_process.max_memory_needed;
+        image[current_address + 9] = current_process.main_memory_base;
+
+        int num_instructions = current_process.num_instructions;
+        int instruction_address = current_process.instruction_base;
+        int data_end = current_process.instruction_base + current_process.memory_limit; // end of the block, operands past here were read as -1 by finishDecodingJob
+        const Instruction *code = jobCode(sim, current_process.first_instruction);
+
+        for (int i = 0; i < num_instructions && instruction_address < data_end; i++) 
+        {
+            const Instruction &current_instruction = code[i];
+            int op_code = current_instruction.op_code;
+            int data_address = current_process.data_base + current_instruction.data_offset;
+           
+            image[instruction_address++] = op_code; 
+
+            if ((op_code == 1 || op_code == 3) && data_address + 1 < data_end) // compute and store: 2 parameters
+            {  
+                image[data_address] = current_instruction.operand_1;
+                image[data_address + 1] = current_instruction.operand_2;
+            }
+            else if ((op_code == 2 || op_code == 4) && data_address < data_end) // print and load: 1 parameter
+            { 
+                image[data_address] = current_instruction.operand_1;
+            }
+        }
+
+        int slot = addProcess(sim, current_process.main_memory_base, current_process.first_instruction, current_process.arrival_time);
+        recordLatency(sim.metrics.new_job_wait, sim.CPU_clock - current_process.arrival_time);
+
+        pushReady(sim, slot);
+
+        if (sim.log_level >= LOG_TRANSITIONS && sim.CPU_clock > 0)
+        {
+            logAdmission(*sim.log, sim.CPU_clock, current_process.process_id, current_address, sim.CPU_clock - current_process.arrival_time);
+        }
+
+    } // END WHILE
+} // END FUNCTION
+
+// a job's decoded instructions: its run of the shared instructionStream, or with --stream the code it was read with
+inline const Instruction *jobCode(const Simulation &sim, int first_instruction)
+{
+    if (sim.stream)
+    {
+        return sim.stream->jobs[first_instruction].code.data();
+    }
+    return sim.workload->instructionStream.data() + first_instruction;
+} // END FUNCTION
+
+// the same for the schedulers' burst estimates
+inline const int *jobBurst(const Simulation &sim, int first_instruction)
+{
+    if (sim.stream)
+    {
+        return sim.stream->jobs[first_instruction].remainingBurst.data();
+    }
+    return sim.workload->remainingBurst.data() + first_instruction;
+} // END FUNCTION
+
+// --stream: a job is done with, its code is freed for good and its process slot, -1 if it never got one, is up for reuse
+void releaseStreamedJob(Simulation &sim, int job, int slot)
+{
+    JobStream &stream = *sim.stream;
+    std::vector<Instruction>().swap(stream.jobs[job].code);
+    std::vector<int>().swap(stream.jobs[job].remainingBurst);
+    stream.free_jobs.push_back(job);
+    stream.live_jobs--;
+
+    if (slot >= 0)
+    {
+        stream.finished_cycles += sim.pcbTable[slot].CPU_cycles_used;
+        stream.free_slots.push_back(slot);
+    }
+} // END FUNCTION
+
+// gives the PCB just written at base a process slot, both halves filled in from its header words, admitted now
+int addProcess(Simulation &sim, int base, int first_instruction, int arrival_time)
+{
+    const std::vector<int> &image = sim.config.paging ? sim.paged.backingStore : sim.mainMemory;
+    int slot = sim.pcbTable.size();
+    if (sim.stream && !sim.stream->free_slots.empty())
+    {
+        slot = sim.stream->free_slots.back();
+        sim.stream->free_slots.pop_back();
+    }
+
+    HotPCB pcb;
+    pcb.process_id = image[base];
+    pcb.state = image[base + 1];
+    pcb.program_counter = image[base + 2];
+    pcb.CPU_cycles_used = image[base + 6];
+    pcb.register_value = image[base + 7];
+    pcb.instruction_base = image[base + 3];
+    pcb.num_instructions = image[base + 4] - image[base + 3]; // data_base - instruction_base
+    pcb.max_memory_needed = image[base + 8];
+    pcb.compute_left = 0;
+    pcb.first_instruction = first_instruction;
+    pcb.ready_since = 0;
+    pcb.waiting_time = 0;
+    pcb.first_run_time = -1;
+    pcb.context_switches = 0;
+    pcb.level = -1;
+    pcb.core = -1;
+
+    ProcessRecord record;
+    record.arrival_time = arrival_time;
+    record.main_memory_base = base;
+    record.page_table_base = -1;
+    if (sim.config.paging)
+    {
+        record.page_table_base = sim.paged.pages_used;
+        sim.paged.pages_used += (std::max(0, pcb.max_memory_needed) + sim.paged.frame_mask) >> sim.paged.frame_shift;
+    }
+    record.data_base = image[base + 4];
+    record.memory_limit = image[base + 5];
+    record.admitted_time = sim.CPU_clock;
+    record.completion_time = -1;
+    record.IO_wait_time = 0;
+    record.timeouts = 0;
+    record.IO_waits = 0;
+
+    if (slot == (int)sim.pcbTable.size())
+    {
+        sim.pcbTable.push_back(pcb);
+        sim.processes.push_back(record);
+    }
+    else
+    {
+        sim.pcbTable[slot] = pcb;
+        sim.processes[slot] = record;
+    }
+
+    if (!sim.config.paging)
+    {
+        sim.processSlotAt[base] = slot;
+    }
+    return slot;
+} // END FUNCTION
+
+// puts a process in the readyQueue and notes when, so its waiting time can be charged at dispatch
+void pushReady(Simulation &sim, int slot)
+{
+    HotPCB &pcb = sim.pcbTable[slot];
+    pcb.ready_since = sim.CPU_clock;
+
+    if (!sim.cores.empty())
+    {
+        // SMP: back to the core it last ran on, a new process goes to the shortest run queue
+        if (pcb.core < 0)
+        {
+            pcb.core = 0;
+            for (size_t c = 1; c < sim.cores.size(); c++)
+            {
+                if (sim.cores[c].runQueue.size() < sim.cores[pcb.core].runQueue.size())
+                {
+                    pcb.core = c;
+                }
+            }
+        }
+        sim.cores[pcb.core].runQueue.push_back(slot);
+        return;
+    }
+
+    Scheduler &scheduler = sim.readyQueue;
+    scheduler.count++;
+
+    if (scheduler.policy == POLICY_RR || scheduler.policy == POLICY_FCFS)
+    {
+        scheduler.fifo.push(slot);
+        return;
+    }
+
+    if (scheduler.policy == POLICY_SRTF)
+    {
+        SRTFEntry entry;
+        entry.remaining = remainingBurst(sim, slot);
+        entry.sequence = scheduler.sequence++;
+        entry.slot = slot;
+        scheduler.shortest.push(entry);
+        return;
+    }
+
+    // priority and mlfq: first time in, the bucket comes from the whole job's estimate, after that it is kept (priority) or moved by executeCPU (mlfq)
+    if (pcb.level < 0)
+    {
+        pcb.level = burstLevel(sim, remainingBurst(sim, slot));
+    }
+    LevelEntry entry;
+    entry.slot = slot;
+    entry.since = sim.CPU_clock;
+    scheduler.buckets[pcb.level].push(entry);
+    scheduler.occupied |= 1u << pcb.level;
+} // END FUNCTION
+
+void initScheduler(Scheduler &scheduler, int policy, int levels, int aging)
+{
+    scheduler.policy = policy;
+    scheduler.levels = levels;
+    scheduler.aging = aging;
+    scheduler.count = 0;
+    scheduler.fifo = std::queue<int>();
+    scheduler.shortest = std::priority_queue<SRTFEntry, std::vector<SRTFEntry>, SRTFLater>();
+    scheduler.buckets.assign(levels, std::queue<LevelEntry>());
+    scheduler.occupied = 0;
+    scheduler.sequence = 0;
+} // END FUNCTION
+
+// CPU ticks the process still has to run, from its program counter to the end of its code
+int remainingBurst(const Simulation &sim, int slot)
+{
+    const HotPCB &pcb = sim.pcbTable[slot];
+    if (pcb.program_counter >= pcb.num_instructions)
+    {
+        return 0; // its last instruction was a print, nothing left but to terminate
+    }
+    int remaining = jobBurst(sim, pcb.first_instruction)[pcb.program_counter];
+    if (pcb.compute_left > 0)
+    {
+        remaining -= jobCode(sim, pcb.first_instruction)[pcb.program_counter].operand_2 - pcb.compute_left; // part of it already ran
+    }
+    return remaining;
+} // END FUNCTION
+
+// bucket for a burst: 0 if it fits in one slice, then one bucket per doubling of the slices it needs
+int burstLevel(const Simulation &sim, int burst)
+{
+    int slices = burst / std::max(1, sim.CPU_allocated_time);
+    int level = 0;
+    while ((slices >>= 1) > 0 && level < sim.readyQueue.levels - 1)
+    {
+        level++;
+    }
+    return std::min(level, sim.readyQueue.levels - 1);
+} // END FUNCTION
+
+// takes the process the policy runs next out of the readyQueue, which must not be empty
+int popReady(Simulation &sim)
+{
+    Scheduler &scheduler = sim.readyQueue;
+    scheduler.count--;
+
+    if (scheduler.policy == POLICY_RR || scheduler.policy == POLICY_FCFS)
+    {
+        int slot = scheduler.fifo.front();
+        scheduler.fifo.pop();
+        return slot;
+    }
+
+    if (scheduler.policy == POLICY_SRTF)
+    {
+        int slot = scheduler.shortest.top().slot;
+        scheduler.shortest.pop();
+        return slot;
+    }
+
+    if (scheduler.policy == POLICY_MLFQ)
+    {
+        // aging: every process that has waited scheduler.aging ticks in a lower queue moves up one level, and waits that
+        // long again there before the next promotion. Buckets are in order of since, so the aged ones are at the front
+        for (int level = 1; level < scheduler.levels; level++)
+        {
+            std::queue<LevelEntry> &bucket = scheduler.buckets[level];
+            while (!bucket.empty() && sim.CPU_clock - bucket.front().since >= scheduler.aging)
+            {
+                LevelEntry promoted = bucket.front();
+                bucket.pop();
+                sim.pcbTable[promoted.slot].level = level - 1;
+                promoted.since = sim.CPU_clock;
+                scheduler.buckets[level - 1].push(promoted);
+                scheduler.occupied |= 1u << (level - 1);
+            }
+            if (bucket.empty())
+            {
+                scheduler.occupied &= ~(1u << level);
+            }
+        }
+    }
+
+    int level = 0; // lowest non empty bucket
+#if defined(__GNUC__) || defined(__clang__)
+    level = __builtin_ctz(scheduler.occupied);
+#else
+    while (!(scheduler.occupied & (1u << level)))
+    {
+        level++;
+    }
+#endif
+
+    std::queue<LevelEntry> &bucket = scheduler.buckets[level];
+    int slot = bucket.front().slot;
+    bucket.pop();
+    if (bucket.empty())
+    {
+        scheduler.occupied &= ~(1u << level);
+    }
+    return slot;
+} // END FUNCTION
+
+// how long a process may keep the CPU this dispatch
+int timeSlice(const Simulation &sim, const HotPCB &pcb)
+{
+    if (sim.readyQueue.policy == POLICY_FCFS)
+    {
+        return std::numeric_limits<int>::max();
+    }
+    if (sim.readyQueue.policy == POLICY_MLFQ)
+    {
+        return sim.CPU_allocated_time << std::min(pcb.level, 16); // each level down doubles the slice
+    }
+    return sim.CPU_allocated_time;
+} // END FUNCTION
+
+void startEventLog(EventLog &log, int level, int format, FILE *out)
+{
+    log.level = level;
+    log.format = format;
+    log.out = out;
+    log.ring.resize(EVENT_RING_SIZE);
+    log.head.store(0);
+    log.tail.store(0);
+    log.done.store(false);
+    log.writer = std::thread(eventWriter, &log);
+} // END FUNCTION
+
+// the only thing the simulator does per event: copy a few ints into the ring and publish them
+inline void logEvent(EventLog &log, int clock, int process_id, int type, int value)
+{
+    EventRecord &event = claimEvent(log);
+    event.clock = clock;
+    event.process_id = process_id;
+    event.type = type;
+    event.value = value;
+
+    publishEvent(log);
+} // END FUNCTION
+
+// EVENT_ADMITTED, with how long the job sat in the newJobQueue
+inline void logAdmission(EventLog &log, int clock, int process_id, int address, int waited)
+{
+    EventRecord &event = claimEvent(log);
+    event.clock = clock;
+    event.process_id = process_id;
+    event.type = EVENT_ADMITTED;
+    event.value = address;
+    event.waited = waited;
+
+    publishEvent(log);
+} // END FUNCTION
+
+// the ring record the next event goes in, once the writer has made room for it. Only the simulator moves head
+inline EventRecord &claimEvent(EventLog &log)
+{
+    size_t head = log.head.load(std::memory_order_relaxed);
+    if (head - log.tail.load(std::memory_order_acquire) >= EVENT_RING_SIZE)
+    {
+        // ring is full, sleep until the writer has drained some of it
+        std::unique_lock<std::mutex> lock(log.wait_lock);
+        log.has_events.notify_one();
+        while (head - log.tail.load(std::memory_order_acquire) >= EVENT_RING_SIZE)
+        {
+            log.has_room.wait_for(lock, EVENT_WAIT);
+        }
+    }
+    return log.ring[head & (EVENT_RING_SIZE - 1)];
+} // END FUNCTION
+
+// hands the claimed record to the writer, waking it once per batch rather than once per event
+inline void publishEvent(EventLog &log)
+{
+    size_t head = log.head.load(std::memory_order_relaxed) + 1;
+    log.head.store(head, std::memory_order_release);
+    if ((head & (EVENT_WAKE_BATCH - 1)) == 0)
+    {
+        log.has_events.notify_one();
+    }
+} // END FUNCTION
+
+// no more events: let the writer drain the ring and wait for it to finish
+void stopEventLog(EventLog &log)
+{
+    log.done.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(log.wait_lock); // the writer is either past its check of done or already asleep
+        log.has_events.notify_one();
+    }
+    log.writer.join();
+} // END FUNCTION
+
+/*
+* Writer thread. Formats everything between tail and head into one text buffer and writes it out once the buffer is
+* big or the ring runs dry, so the output is a few large fwrites instead of one write per line.
+*/
+void eventWriter(EventLog *log)
+{
+    const size_t flush_size = 1 << 20;
+
+    std::string text;
+    text.reserve(flush_size + 256);
+
+    while (true)
+    {
+        size_t tail = log->tail.load(std::memory_order_relaxed);
+        size_t head = log->head.load(std::memory_order_acquire);
+
+        if (tail == head)
+        {
+            if (!text.empty())
+            {
+                fwrite(text.data(), 1, text.size(), log->out);
+                text.clear();
+            }
+
+            if (log->done.load(std::memory_order_acquire) && head == log->head.load(std::memory_order_acquire))
+            {
+                break;
+            }
+
+            // nothing to format, sleep until the simulator has a batch, is done, or EVENT_WAIT is up
+            std::unique_lock<std::mutex> lock(log->wait_lock);
+            if (head == log->head.load(std::memory_order_acquire) && !log->done.load(std::memory_order_acquire))
+            {
+                log->has_events.wait_for(lock, EVENT_WAIT);
+            }
+            continue;
+        }
+
+        for (; tail != head; tail++)
+        {
+            formatEvent(log->ring[tail & (EVENT_RING_SIZE - 1)], log->format, text);
+            if (text.size() >= flush_size)
+            {
+                fwrite(text.data(), 1, text.size(), log->out);
+                text.clear();
+            }
+        }
+        log->tail.store(tail, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(log->wait_lock); // a full simulator sleeps under the lock, so this cannot slip past it
+            log->has_room.notify_one();
+        }
+    }
+
+    fflush(log->out);
+} // END FUNCTION
+
+// one event as a line of text (the same lines the simulator has always printed) or as a JSON object
+void formatEvent(const EventRecord &event, int format, std::string &text)
+{
+    static const char *const names[] = { "running", "timeout", "io_wait", "io_done", "admitted",
+                                         "compute", "print", "stored", "store_error", "loaded", "load_error",
+                                         "terminated", "finished" };
+
+    // queue transitions as (from, to), executed instructions stay on the CPU
+    static const char *const from_queue[] = { "ready", "running", "running", "io_waiting", "new" };
+    static const char *const to_queue[] = { "running", "ready", "io_waiting", "ready", "ready" };
+
+    if (format == LOG_FORMAT_JSON && event.type == EVENT_FINISHED)
+    {
+        text += "{\"clock\":";
+        appendInt(text, event.clock);
+        text += ",\"event\":\"finished\",\"total_cpu_time\":";
+        appendInt(text, event.clock);
+        text += "}\n";
+        return;
+    }
+
+    if (format == LOG_FORMAT_JSON)
+    {
+        text += "{\"clock\":";
+        appendInt(text, event.clock);
+        text += ",\"pid\":";
+        appendInt(text, event.process_id);
+        text += ",\"event\":\"";
+        text += names[event.type];
+        text += "\"";
+
+        if (event.type <= EVENT_ADMITTED)
+        {
+            text += ",\"from\":\"";
+            text += from_queue[event.type];
+            text += "\",\"to\":\"";
+            text += to_queue[event.type];
+            text += "\"";
+            if (event.type == EVENT_ADMITTED)
+            {
+                text += ",\"address\":";
+                appendInt(text, event.value);
+                text += ",\"waited\":";
+                appendInt(text, event.waited);
+            }
+        }
+        else if (event.type == EVENT_TERMINATED)
+        {
+            text += ",\"from\":\"running\",\"to\":\"terminated\",\"first_run\":";
+            appendInt(text, event.value);
+            text += ",\"execution_time\":";
+            appendInt(text, event.clock - event.value);
+        }
+        else
+        {
+            text += ",\"opcode\":";
+            appendInt(text, event.value);
+        }
+        text += "}\n";
+        return;
+    }
+
+    switch (event.type)
+    {
+    case EVENT_RUNNING:
+        text += "Process ";
+        appendInt(text, event.process_id);
+        text += " has moved to Running.\n";
+        break;
+    case EVENT_TIMEOUT:
+        text += "Process ";
+        appendInt(text, event.process_id);
+        text += " has a TimeOUT interrupt and is moved to the ReadyQueue.\n";
+        break;
+    case EVENT_IO_WAIT:
+        text += "Process ";
+        appendInt(text, event.process_id);
+        text += " issued an IOInterrupt and moved to the IOWaitingQueue.\n";
+        break;
+    case EVENT_IO_DONE:
+        text += "Process ";
+        appendInt(text, event.process_id);
+        text += " completed I/O and is moved to the ReadyQueue.\n";
+        break;
+    case EVENT_ADMITTED:
+        text += "Process ";
+        appendInt(text, event.process_id);
+        text += " loaded into main memory at ";
+        appendInt(text, event.value);
+        text += " after waiting ";
+        appendInt(text, event.waited);
+        text += " ticks.\n";
+        break;
+    case EVENT_COMPUTE:
+        text += "compute\n";
+        break;
+    case EVENT_PRINT:
+        text += "print\n";
+        break;
+    case EVENT_STORED:
+        text += "stored\n";
+        break;
+    case EVENT_STORE_ERROR:
+        text += "store error!\n";
+        break;
+    case EVENT_LOADED:
+        text += "loaded\n";
+        break;
+    case EVENT_LOAD_ERROR:
+        text += "load error!\n";
+        break;
+    case EVENT_TERMINATED:
+        text += "Process ";
+        appendInt(text, event.process_id);
+        text += " terminated. Entered running state at: ";
+        appendInt(text, event.value);
+        text += ". Terminated at: ";
+        appendInt(text, event.clock);
+        text += ". Total Execution Time: ";
+        appendInt(text, event.clock - event.value);
+        text += ".\n";
+        break;
+    case EVENT_FINISHED:
+        text += "Total CPU time used: ";
+        appendInt(text, event.clock);
+        text += ".\n";
+        break;
+    }
+} // END FUNCTION
+
+void appendInt(std::string &text, long long value)
+{
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr - digits);
+} // END FUNCTION
+
+// Step 4: Process execution, round robin until every job has terminated
+void runSimulation(Simulation &sim)
+{
+    if (!sim.cores.empty())
+    {
+        runSMP(sim);
+        return;
+    }
+
+    if (sim.profile != nullptr)
+    {
+        runSingleCPU<true>(sim);
+    }
+    else
+    {
+        runSingleCPU<false>(sim);
+    }
+} // END FUNCTION
+
+// the classic loop: one CPU, dispatch whatever the scheduler picks until nothing is left
+template <bool Profiled>
+void runSingleCPU(Simulation &sim)
+{
+    unsigned long long started = 0;
+
+    while (sim.readyQueue.count > 0 || !sim.IOWaitingQueue.empty() || (sim.stream && sim.stream->has_next))
+    {
+        // between two dispatches nothing is half done, so this is where a --checkpoint snapshot is taken
+        if (sim.next_checkpoint >= 0 && (sim.CPU_clock >= sim.next_checkpoint || checkpoint_requested))
+        {
+            takeCheckpoint(sim);
+        }
+
+        if (sim.stream)
+        {
+            admitArrivals(sim);
+        }
+
+        if (sim.readyQueue.count == 0)
+        {
+            // nothing can run, the clock still moves by the context switch time while we wait on I/O or the next
+            // arrival. Nothing can happen before then, so every idle step up to it is charged at once
+            int next_event = sim.IOWaitingQueue.empty() ? std::numeric_limits<int>::max() : sim.IOWaitingQueue.top().completion_time;
+            if (sim.stream && sim.stream->has_next)
+            {
+                next_event = std::min(next_event, sim.stream->next.arrival_time);
+            }
+            sim.CPU_clock = idleUntil(sim.CPU_clock, next_event, sim.context_switch_time);
+            if constexpr (Profiled)
+            {
+                started = sim.profile->io_ticks;
+            }
+            checkIOWaitingQueue<Profiled>(sim);
+            if constexpr (Profiled)
+            {
+                sim.profile->idle_io_ticks += sim.profile->io_ticks - started;
+            }
+            continue;
+        }
+
+        if constexpr (Profiled)
+        {
+            started = hostTicks();
+        }
+        int slot = popReady(sim);
+        if constexpr (Profiled)
+        {
+            sim.profile->select_ticks += hostTicks() - started;
+            sim.profile->selects++;
+        }
+
+        HotPCB &pcb = sim.pcbTable[slot];
+        pcb.waiting_time += sim.CPU_clock - pcb.ready_since;
+        pcb.context_switches++;
+        recordLatency(sim.metrics.ready_wait, sim.CPU_clock - pcb.ready_since);
+
+        sim.CPU_clock += sim.context_switch_time; // every dispatch costs a context switch
+        executeCPU<Profiled>(sim, slot);
+    }
+
+    if (sim.log_level >= LOG_TRANSITIONS)
+    {
+        logEvent(*sim.log, sim.CPU_clock, 0, EVENT_FINISHED, 0);
+    }
+} // END FUNCTION
+
+// --stream: every job whose arrival time the clock has reached goes to the newJobQueue, then in as memory allows
+void admitArrivals(Simulation &sim)
+{
+    JobStream &stream = *sim.stream;
+    if (!stream.has_next || stream.next.arrival_time > sim.CPU_clock)
+    {
+        return;
+    }
+
+    while (stream.has_next && stream.next.arrival_time <= sim.CPU_clock)
+    {
+        sim.newJobQueue.push(stream.next);
+        readStreamedJob(stream);
+    }
+    loadJobsToMemory(sim);
+} // END FUNCTION
+
+// writes the --checkpoint file and schedules the next one, a failed write is reported and the run carries on
+void takeCheckpoint(Simulation &sim)
+{
+    writeCheckpoint(checkpoint_path, sim);
+    checkpoint_requested = 0;
+    sim.next_checkpoint = checkpoint_every > 0 ? sim.CPU_clock + checkpoint_every : std::numeric_limits<int>::max();
+} // END FUNCTION
+
+/*
+* Serializes the simulation into one buffer in the checkpoint layout and writes it with a single write, to a temporary
+* file that is then renamed over the last checkpoint, so a crash mid-write still leaves the previous one whole.
+*/
+bool writeCheckpoint(const std::string &path, const Simulation &sim)
+{
+    const Workload &workload = *sim.workload;
+    const PagedMemory &paged = sim.paged;
+
+    // queues come out in pop order, pushing them back in that order rebuilds them exactly
+    std::vector<SRTFEntry> ready;
+    ready.reserve(sim.readyQueue.count);
+    std::queue<int> fifo = sim.readyQueue.fifo;
+    for (; !fifo.empty(); fifo.pop())
+    {
+        SRTFEntry entry;
+        entry.remaining = 0;
+        entry.sequence = 0;
+        entry.slot = fifo.front();
+        ready.push_back(entry);
+    }
+    std::priority_queue<SRTFEntry, std::vector<SRTFEntry>, SRTFLater> shortest = sim.readyQueue.shortest;
+    for (; !shortest.empty(); shortest.pop())
+    {
+        ready.push_back(shortest.top());
+    }
+    for (size_t level = 0; level < sim.readyQueue.buckets.size(); level++)
+    {
+        std::queue<LevelEntry> bucket = sim.readyQueue.buckets[level];
+        for (; !bucket.empty(); bucket.pop())
+        {
+            SRTFEntry entry;
+            entry.remaining = level;
+            entry.sequence = bucket.front().since; // bucket entries carry their aging time stamp here
+            entry.slot = bucket.front().slot;
+            ready.push_back(entry);
+        }
+    }
+
+    std::vector<IOWaitEntry> waiting;
+    waiting.reserve(sim.IOWaitingQueue.size());
+    for (IOWaitQueue queue = sim.IOWaitingQueue; !queue.empty(); queue.pop())
+    {
+        waiting.push_back(queue.top());
+    }
+
+    std::vector<PCB> new_jobs;
+    new_jobs.reserve(sim.newJobQueue.size());
+    for (std::queue<PCB> queue = sim.newJobQueue; !queue.empty(); queue.pop())
+    {
+        new_jobs.push_back(queue.front());
+    }
+
+    std::vector<int> free_blocks;
+    free_blocks.reserve(2 * sim.memory.free_by_address.size());
+    for (std::map<int, int>::const_iterator block = sim.memory.free_by_address.begin(); block != sim.memory.free_by_address.end(); ++block)
+    {
+        free_blocks.push_back(block->first);
+        free_blocks.push_back(block->second);
+    }
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header)); // padding too, so the same state always writes the same bytes
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.max_memory = sim.mainMemory.size();
+    header.context_switch_time = sim.context_switch_time;
+    header.CPU_allocated_time = sim.CPU_allocated_time;
+    header.num_processes = workload.num_processes;
+    header.policy = sim.readyQueue.policy;
+    header.levels = sim.readyQueue.levels;
+    header.aging = sim.readyQueue.aging;
+    header.split_compute = sim.config.split_compute;
+    header.mirror_pcb = sim.config.mirror_pcb;
+    header.paging = sim.config.paging;
+    header.page_policy = sim.config.page_policy;
+    header.frame_size = sim.config.frame_size;
+    header.tlb_entries = sim.config.paging ? paged.tlb.size() : 0;
+    header.page_fault_cost = sim.config.page_fault_cost;
+    header.CPU_clock = sim.CPU_clock;
+    header.rejected_jobs = sim.rejected_jobs;
+    header.IO_sequence = sim.IO_sequence;
+    header.ready_sequence = sim.readyQueue.sequence;
+    header.instructions_executed = sim.instructions_executed;
+    header.words_in_use = sim.memory.words_in_use;
+    header.peak_words_in_use = sim.memory.peak_words_in_use;
+    header.allocations = sim.memory.allocations;
+    header.frees = sim.memory.frees;
+    header.failed_admissions = sim.memory.failed_admissions;
+    header.fragmentation_sum = sim.memory.fragmentation_sum;
+    header.worst_fragmentation = sim.memory.worst_fragmentation;
+    header.instructions = workload.instructionStream.size();
+    header.processes = sim.pcbTable.size();
+    header.new_jobs = new_jobs.size();
+    header.ready = ready.size();
+    header.IO_waiting = waiting.size();
+    header.free_blocks = free_blocks.size() / 2;
+    if (sim.config.paging)
+    {
+        header.oldest = paged.oldest;
+        header.newest = paged.newest;
+        header.hand = paged.hand;
+        header.backing_used = paged.backing_used;
+        header.pages_used = paged.pages_used;
+        header.tlb_hits = paged.tlb_hits;
+        header.tlb_misses = paged.tlb_misses;
+        header.faults = paged.faults;
+        header.fault_ticks = paged.fault_ticks;
+        header.evictions = paged.evictions;
+        header.write_backs = paged.write_backs;
+        header.backing_words = paged.backingStore.size();
+        header.pages = paged.pageTable.size();
+        header.frames = paged.frame.size();
+        header.free_frames = paged.freeFrames.size();
+    }
+
+    std::string buffer;
+    buffer.reserve(sizeof(header) + workload.instructionStream.size() * (sizeof(Instruction) + sizeof(int)) + sim.mainMemory.size() * sizeof(int)
+                   + sim.pcbTable.size() * (sizeof(HotPCB) + sizeof(ProcessRecord)) + sizeof(QueueMetrics)
+                   + paged.backingStore.size() * sizeof(int) + paged.frame.size() * sizeof(PageFrame));
+    buffer.append((const char *)&header, sizeof(header));
+    buffer.append((const char *)workload.instructionStream.data(), workload.instructionStream.size() * sizeof(Instruction));
+    buffer.append((const char *)workload.remainingBurst.data(), workload.remainingBurst.size() * sizeof(int));
+    buffer.append((const char *)sim.mainMemory.data(), sim.mainMemory.size() * sizeof(int));
+    buffer.append((const char *)sim.pcbTable.data(), sim.pcbTable.size() * sizeof(HotPCB));
+    buffer.append((const char *)sim.processes.data(), sim.processes.size() * sizeof(ProcessRecord));
+    buffer.append((const char *)new_jobs.data(), new_jobs.size() * sizeof(PCB));
+    buffer.append((const char *)ready.data(), ready.size() * sizeof(SRTFEntry));
+    buffer.append((const char *)waiting.data(), waiting.size() * sizeof(IOWaitEntry));
+    buffer.append((const char *)free_blocks.data(), free_blocks.size() * sizeof(int));
+    buffer.append((const char *)&sim.metrics, sizeof(QueueMetrics));
+    if (sim.config.paging)
+    {
+        buffer.append((const char *)paged.backingStore.data(), paged.backingStore.size() * sizeof(int));
+        buffer.append((const char *)paged.pageTable.data(), paged.pageTable.size() * sizeof(int));
+        buffer.append((const char *)paged.tlb.data(), paged.tlb.size() * sizeof(TLBEntry));
+        buffer.append((const char *)paged.frame.data(), paged.frame.size() * sizeof(PageFrame));
+        buffer.append((const char *)paged.freeFrames.data(), paged.freeFrames.size() * sizeof(int));
+    }
+
+    std::string temporary_path = path + ".tmp";
+    std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "ERROR: could not create checkpoint " << temporary_path << "\n";
+        return false;
+    }
+    out.write(buffer.data(), buffer.size());
+    out.close();
+
+    if (!out || std::rename(temporary_path.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "ERROR: failed writing checkpoint " << path << "\n";
+        return false;
+    }
+    return true;
+} // END FUNCTION
+
+/*
+* Where an idle CPU's clock ends up: the spec charges context_switch_time per idle step, so this is the first whole
+* step at or after next_event, worked out in one division instead of one loop pass per step. With no switch cost the
+* clock goes straight to the event.
+*/
+int idleUntil(int clock, int next_event, int context_switch_time)
+{
+    if (context_switch_time <= 0)
+    {
+        return next_event;
+    }
+    int steps = std::max(1, (next_event - clock + context_switch_time - 1) / context_switch_time);
+    return clock + steps * context_switch_time;
+} // END FUNCTION
+
+/*
+* SMP mode. Every core acts at its own clock, and the cores act in clock order (lowest core first on a tie), which makes
+* the run the same as one where the cores really ran side by side. A core acting means: commit the slice it finished
+* (finishSlice, at the slice's end time, so other cores see its I/O, timeout or termination only from then on), then
+* take the next process from its run queue, steal one, or idle for a context switch.
+*
+* A dispatch costs at least context_switch_time before its slice can end, so every core whose clock is less than that
+* ahead of the earliest one can make its decision before any slice of this window commits. Their slices do not touch
+* each other (each process only reads and writes its own block of mainMemory), so they are executed after all the
+* decisions, on host threads when --host-threads asks for it and nothing is being logged.
+*/
+void runSMP(Simulation &sim)
+{
+    std::vector<Core> &cores = sim.cores;
+    int num_cores = cores.size();
+    std::vector<int> window;    // cores deciding in this window, in clock order
+    std::vector<int> executing; // the ones among them that dispatched a slice
+
+    // host threads: wait for a new generation of executing, then take slices off it until none are left
+    unsigned int threads = (sim.log_level == LOG_OFF && !sim.config.paging) ? std::min<unsigned int>(sim.config.host_threads, num_cores) : 0; // frames are shared by every core
+    std::atomic<unsigned int> generation(0);
+    std::atomic<size_t> next_slice(0);
+    std::atomic<size_t> slices_done(0);
+    std::atomic<bool> stop(false);
+
+    auto runSlices = [&]()
+    {
+        for (size_t i = next_slice++; i < executing.size(); i = next_slice++)
+        {
+            Core &core = cores[executing[i]];
+            core.exit_reason = runSlice<false>(sim, core.cpu);
+            slices_done++;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threads; t++) // this thread is the first worker
+    {
+        workers.emplace_back([&]()
+        {
+            unsigned int seen = 0;
+            while (true)
+            {
+                while (generation.load(std::memory_order_acquire) == seen && !stop.load(std::memory_order_acquire))
+                {
+                    std::this_thread::yield();
+                }
+                if (stop.load(std::memory_order_acquire))
+                {
+                    return;
+                }
+                seen = generation.load(std::memory_order_acquire);
+                runSlices();
+            }
+        });
+    }
+
+    bool finished = false;
+    while (!finished)
+    {
+        int first = 0;
+        for (int c = 1; c < num_cores; c++)
+        {
+            if (cores[c].clock < cores[first].clock)
+            {
+                first = c;
+            }
+        }
+
+        window.clear();
+        if (sim.context_switch_time > 0)
+        {
+            for (int c = 0; c < num_cores; c++)
+            {
+                if (cores[c].clock < cores[first].clock + sim.context_switch_time)
+                {
+                    window.push_back(c);
+                }
+            }
+            std::stable_sort(window.begin(), window.end(), [&cores](int a, int b) { return cores[a].clock < cores[b].clock; });
+        }
+        else
+        {
+            window.push_back(first); // no lookahead, one core at a time
+        }
+
+        executing.clear();
+        for (size_t i = 0; i < window.size() && !finished; i++)
+        {
+            int c = window[i];
+            if (dispatchCore(sim, c))
+            {
+                executing.push_back(c);
+            }
+            else if (cores[c].running < 0 && cores[c].runQueue.empty() && sim.IOWaitingQueue.empty())
+            {
+                // idle with nothing to steal: the run is over unless another core still has a slice in flight
+                finished = true;
+                for (int other = 0; other < num_cores; other++)
+                {
+                    if (cores[other].running >= 0)
+                    {
+                        finished = false;
+                    }
+                }
+            }
+        }
+
+        if (threads > 1 && executing.size() > 1)
+        {
+            next_slice = 0;
+            slices_done = 0;
+            generation.fetch_add(1, std::memory_order_release);
+            runSlices();
+            while (slices_done.load(std::memory_order_acquire) < executing.size())
+            {
+                std::this_thread::yield();
+            }
+        }
+        else
+        {
+            next_slice = 0;
+            runSlices();
+        }
+
+        for (size_t i = 0; i < executing.size(); i++)
+        {
+            Core &core = cores[executing[i]];
+            core.busy_ticks += core.cpu.clock - core.clock;
+            core.clock = core.cpu.clock;
+            sim.instructions_executed += core.cpu.instructions;
+        }
+    }
+
+    stop = true;
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+
+    sim.CPU_clock = 0;
+    for (int c = 0; c < num_cores; c++)
+    {
+        sim.CPU_clock = std::max(sim.CPU_clock, cores[c].clock);
+    }
+
+    if (sim.log_level >= LOG_TRANSITIONS)
+    {
+        logEvent(*sim.log, sim.CPU_clock, 0, EVENT_FINISHED, 0);
+    }
+} // END FUNCTION
+
+/*
+* Core c acts at its clock: commits its finished slice, then starts the next one (true) or idles (false). An idle core
+* skips to the next thing that could give it work, an I/O completion or another core's slice ending, in whole context
+* switch steps like the single CPU.
+*/
+bool dispatchCore(Simulation &sim, int c)
+{
+    Core &core = sim.cores[c];
+    sim.CPU_clock = core.clock;
+
+    if (core.running >= 0)
+    {
+        finishSlice<false>(sim, core.running, core.cpu, core.exit_reason);
+        core.running = -1;
+    }
+    else
+    {
+        checkIOWaitingQueue<false>(sim);
+    }
+
+    int slot = -1;
+    if (!core.runQueue.empty())
+    {
+        slot = core.runQueue.front();
+        core.runQueue.pop_front();
+    }
+    else
+    {
+        int victim = -1;
+        for (size_t other = 0; other < sim.cores.size(); other++)
+        {
+            if (!sim.cores[other].runQueue.empty() && (victim < 0 || sim.cores[other].runQueue.size() > sim.cores[victim].runQueue.size()))
+            {
+                victim = other;
+            }
+        }
+        if (victim >= 0)
+        {
+            slot = sim.cores[victim].runQueue.back();
+            sim.cores[victim].runQueue.pop_back();
+            core.steals++;
+        }
+    }
+
+    if (slot < 0)
+    {
+        bool work_in_flight = !sim.IOWaitingQueue.empty();
+        int next = std::numeric_limits<int>::max();
+        if (!sim.IOWaitingQueue.empty())
+        {
+            next = sim.IOWaitingQueue.top().completion_time;
+        }
+        for (size_t other = 0; other < sim.cores.size(); other++)
+        {
+            if (sim.cores[other].running >= 0)
+            {
+                work_in_flight = true;
+                next = std::min(next, sim.cores[other].clock);
+            }
+        }
+        if (!work_in_flight)
+        {
+            return false; // nothing anywhere, runSMP notices and stops
+        }
+
+        next = idleUntil(core.clock, std::max(next, core.clock + 1), sim.context_switch_time);
+        core.idle_ticks += next - core.clock;
+        core.clock = next;
+        return false;
+    }
+
+    HotPCB &pcb = sim.pcbTable[slot];
+    pcb.waiting_time += core.clock - pcb.ready_since;
+    pcb.context_switches++;
+    recordLatency(sim.metrics.ready_wait, core.clock - pcb.ready_since);
+
+    core.clock += sim.context_switch_time; // every dispatch costs a context switch
+    core.switch_ticks += sim.context_switch_time;
+    if (pcb.core != c)
+    {
+        core.clock += sim.config.migration_cost; // its state has to follow it over, on top of the switch
+        core.switch_ticks += sim.config.migration_cost;
+        core.migrations++;
+        pcb.core = c;
+    }
+    core.dispatches++;
+
+    sim.CPU_clock = core.clock;
+    startSlice(sim, slot, core.cpu, c);
+    core.running = slot;
+    return true;
+} // END FUNCTION
+
+/*
+* Runs the process in the given slot until one of three things happens:
+*   - it has used CPU_allocated_time ticks          -> TimeOUT interrupt, back of the readyQueue
+*   - it executes a print                           -> IOInterrupt, parked in the IOWaitingQueue
+*   - it runs out of instructions                   -> terminated
+* Every one of those is an interrupt, so the IOWaitingQueue is checked before we return.
+* The three steps are separate functions so the SMP loop can run the middle one for several cores at once.
+*/
+template <bool Profiled>
+void executeCPU(Simulation &sim, int slot) 
+{
+    unsigned long long started = 0, interpret_started = 0, io_before = 0;
+    if constexpr (Profiled)
+    {
+        started = hostTicks();
+        io_before = sim.profile->io_ticks;
+    }
+
+    CPUState cpu;
+    startSlice(sim, slot, cpu, 0);
+
+    if constexpr (Profiled)
+    {
+        interpret_started = hostTicks();
+    }
+    int exit_reason = runSlice<Profiled>(sim, cpu);
+    if constexpr (Profiled)
+    {
+        unsigned long long interpreted = hostTicks() - interpret_started;
+        sim.profile->interpret_ticks += interpreted;
+        if ((size_t)slot >= sim.profile->process_ticks.size())
+        {
+            sim.profile->process_ticks.resize(slot + 1, 0);
+        }
+        sim.profile->process_ticks[slot] += interpreted;
+    }
+    sim.CPU_clock = cpu.clock;
+    sim.instructions_executed += cpu.instructions;
+
+    finishSlice<Profiled>(sim, slot, cpu, exit_reason);
+
+    if constexpr (Profiled)
+    {
+        sim.profile->slice_ticks += hostTicks() - started;
+        sim.profile->slice_io_ticks += sim.profile->io_ticks - io_before;
+        sim.profile->slices++;
+    }
+} // END FUNCTION
+
+/*
+* Context switch in: the process's line of the pcbTable into cpu, state to running, at the simulation's CPU_clock.
+* The PCB header in mainMemory is not read, it is only a mirror.
+*/
+void startSlice(Simulation &sim, int slot, CPUState &cpu, int core)
+{
+    HotPCB &pcb = sim.pcbTable[slot];
+
+    cpu.process_id = pcb.process_id;
+    cpu.program_counter = pcb.program_counter;
+    cpu.CPU_cycles_used = pcb.CPU_cycles_used;
+    cpu.register_value = pcb.register_value;
+    cpu.instruction_base = pcb.instruction_base;
+    cpu.max_memory_needed = pcb.max_memory_needed;
+    cpu.num_instructions = pcb.num_instructions;
+    cpu.slice_used = 0;
+    cpu.IO_cycles = 0;
+    cpu.time_slice = timeSlice(sim, pcb);
+    cpu.clock = sim.CPU_clock;
+    cpu.instructions = 0;
+    cpu.compute_left = pcb.compute_left;
+    cpu.page_table_base = sim.processes[slot].page_table_base;
+
+    // decoded instructions for this process, operands already pulled out of the data segment when it was parsed
+    cpu.code = jobCode(sim, pcb.first_instruction);
+
+    pcb.state = STATE_RUNNING;
+    mirrorPCB(sim, slot);
+    if (pcb.first_run_time < 0)
+    {
+        pcb.first_run_time = sim.CPU_clock;
+        recordLatency(sim.metrics.response, sim.CPU_clock - sim.processes[slot].arrival_time);
+    }
+    if (sim.log_level >= LOG_TRANSITIONS)
+    {
+        logEvent(*sim.log, sim.CPU_clock, pcb.process_id, EVENT_RUNNING, core);
+    }
+} // END FUNCTION
+
+// executes until the slice ends, touching only cpu and the process's own block of mainMemory
+template <bool Profiled>
+int runSlice(Simulation &sim, CPUState &cpu)
+{
+    if (sim.config.dispatch == DISPATCH_THREADED)
+    {
+        return runThreaded<Profiled>(sim, cpu, cpu.code);
+    }
+    return runBranching<Profiled>(sim, cpu, cpu.code);
+} // END FUNCTION
+
+// context switch out at the simulation's CPU_clock: cpu back into the process's pcbTable line, then act on why the slice ended
+template <bool Profiled>
+void finishSlice(Simulation &sim, int slot, const CPUState &cpu, int exit_reason)
+{
+    HotPCB &pcb = sim.pcbTable[slot];
+    int process_id = cpu.process_id;
+
+    pcb.program_counter = cpu.program_counter;
+    pcb.CPU_cycles_used = cpu.CPU_cycles_used;
+    pcb.register_value = cpu.register_value;
+    pcb.compute_left = cpu.compute_left;
+
+    if (exit_reason == EXIT_IO)
+    {
+        // the print is handed off to I/O, the process waits there for the print's cycles and gives up the CPU
+        pcb.state = STATE_IO_WAITING;
+        mirrorPCB(sim, slot);
+
+        IOWaitEntry entry;
+        entry.completion_time = sim.CPU_clock + cpu.IO_cycles;
+        entry.sequence = sim.IO_sequence++;
+        entry.slot = slot;
+        entry.entered_time = sim.CPU_clock;
+        sim.IOWaitingQueue.push(entry);
+        sim.processes[slot].IO_waits++;
+
+        if (sim.log_level >= LOG_TRANSITIONS)
+        {
+            logEvent(*sim.log, sim.CPU_clock, process_id, EVENT_IO_WAIT, 0);
+        }
+        checkIOWaitingQueue<Profiled>(sim);
+        return;
+    }
+
+    if (exit_reason == EXIT_TIMEOUT)
+    {
+        pcb.state = STATE_READY;
+        mirrorPCB(sim, slot);
+        sim.processes[slot].timeouts++;
+        if (sim.readyQueue.policy == POLICY_MLFQ && pcb.level < sim.readyQueue.levels - 1)
+        {
+            pcb.level++; // used its whole slice, one level down
+        }
+
+        if (sim.log_level >= LOG_TRANSITIONS)
+        {
+            logEvent(*sim.log, sim.CPU_clock, process_id, EVENT_TIMEOUT, 0);
+        }
+        checkIOWaitingQueue<Profiled>(sim); // waiters that finished during the slice go ahead of us
+        pushReady(sim, slot);
+        return;
+    }
+
+    pcb.state = STATE_TERMINATED;                       // terminate process
+    pcb.program_counter = pcb.instruction_base - 1;     // update program counter for this PCB, to be before instructionBase
+    mirrorPCB(sim, slot);
+    sim.processes[slot].completion_time = sim.CPU_clock;
+    recordLatency(sim.metrics.turnaround, sim.CPU_clock - sim.processes[slot].arrival_time);
+
+    // termination logging: when it first ran, when it terminated and the difference, the per PCB detail is in --metrics
+    if (sim.log_level >= LOG_TRANSITIONS)
+    {
+        logEvent(*sim.log, sim.CPU_clock, process_id, EVENT_TERMINATED, pcb.first_run_time);
+    }
+
+    // hand the block, or the frames, back and let whoever is waiting in the newJobQueue in
+    if (sim.config.paging)
+    {
+        releasePages(sim, slot);
+    }
+    else
+    {
+        int base = sim.processes[slot].main_memory_base;
+        freeBlock(sim.memory, base, 10 + pcb.max_memory_needed);
+        sim.processSlotAt[base] = -1;
+    }
+    if (sim.stream)
+    {
+        releaseStreamedJob(sim, pcb.first_instruction, slot);
+    }
+    loadJobsToMemory(sim);
+
+    checkIOWaitingQueue<Profiled>(sim);
+} // END FUNCTION
+
+// --mirror-pcb: copies the words a context switch changes back into the PCB header in mainMemory
+inline void mirrorPCB(Simulation &sim, int slot)
+{
+    if (sim.config.mirror_pcb)
+    {
+        const HotPCB &pcb = sim.pcbTable[slot];
+        int *header = &(sim.config.paging ? sim.paged.backingStore : sim.mainMemory)[sim.processes[slot].main_memory_base];
+        header[1] = pcb.state;
+        header[2] = pcb.program_counter;
+        header[6] = pcb.CPU_cycles_used;
+        header[7] = pcb.register_value;
+    }
+} // END FUNCTION
+
+// --paging: a terminated process's frames go back on the free stack as they are, nothing of it needs writing back
+void releasePages(Simulation &sim, int slot)
+{
+    PagedMemory &paged = sim.paged;
+    int first_page = sim.processes[slot].page_table_base;
+    int pages = (std::max(0, sim.pcbTable[slot].max_memory_needed) + paged.frame_mask) >> paged.frame_shift;
+
+    for (int page = first_page; page < first_page + pages; page++)
+    {
+        int frame = paged.pageTable[page];
+        if (frame < 0)
+        {
+            continue;
+        }
+        paged.frame[frame].dirty = false;
+        evictPage(sim, frame);
+        paged.freeFrames.push_back(frame);
+    }
+} // END FUNCTION
+
+/*
+* The original interpreter loop: one if / else if chain per instruction. Kept so it can be selected with
+* --dispatch branch and timed against runThreaded on the same input.
+*/
+template <bool Profiled>
+int runBranching(Simulation &sim, CPUState &cpu, const Instruction *code)
+{
+    std::vector<int> &mainMemory = sim.mainMemory;
+
+    // iterate number of instructions or opcodes
+    while (cpu.program_counter < cpu.num_instructions) 
+    {
+        const Instruction &current_instruction = code[cpu.program_counter];
+        int current_op_code = current_instruction.op_code;
+        cpu.instructions++;
+        countOpcode<Profiled>(sim, current_op_code);
+
+        // process each instruction opcode and update the parameters
+
+        if (current_op_code == 1) // COMPUTE
+        {
+            int cycles = computeCycles(cpu, current_instruction.operand_2, sim.config.split_compute);
+            cpu.CPU_cycles_used += cycles;
+            cpu.clock += cycles;
+            cpu.slice_used += cycles;
+            if (cpu.compute_left > 0)
+            {
+                return EXIT_TIMEOUT; // cut at the end of the slice, the same compute carries on next time
+            }
+            if (sim.log_level >= LOG_INSTRUCTIONS)
+            {
+                logEvent(*sim.log, cpu.clock, cpu.process_id, EVENT_COMPUTE, 1);
+            }
+        }
+        else if (current_op_code == 2) // PRINT
+        {
+            cpu.CPU_cycles_used += current_instruction.operand_1;
+            cpu.IO_cycles = current_instruction.operand_1;
+            if (sim.log_level >= LOG_INSTRUCTIONS)
+            {
+                logEvent(*sim.log, cpu.clock, cpu.process_id, EVENT_PRINT, 2);
+            }
+
+            cpu.program_counter++;
+            return EXIT_IO;
+        }
+        else if (current_op_code == 3) // STORE
+        {
+            // check if we are inside data segment
+            if (current_instruction.operand_2 + cpu.instruction_base >= cpu.instruction_base && (current_instruction.operand_2 + cpu.instruction_base) < cpu.max_memory_needed + cpu.instruction_base) 
+            { 
+                int address = sim.config.paging ? pagedAddress(sim, cpu, current_instruction.operand_2, true) : current_instruction.operand_2 + cpu.instruction_base;
+                mainMemory[address] = current_instruction.operand_1;
+                cpu.register_value = current_instruction.operand_1;
+                if (sim.log_level >= LOG_INSTRUCTIONS)
+                {
+                    logEvent(*sim.log, cpu.clock, cpu.process_id, EVENT_STORED, 3);
+                }
+            } 
+            else 
+            {
+                cpu.register_value = current_instruction.operand_1;
+                if (sim.log_level >= LOG_INSTRUCTIONS)
+                {
+                    logEvent(*sim.log, cpu.clock, cpu.process_id, EVENT_STORE_ERROR, 3);
+                }
+            }
+            cpu.CPU_cycles_used++;
+            cpu.clock++;
+            cpu.slice_used++;
+        }
+        // LOAD
+        else if (current_op_code == 4) 
+        {
+            // check if we are inside data segment
+            if ((current_instruction.operand_1 + cpu.instruction_base) >= cpu.instruction_base && (current_instruction.operand_1 + cpu.instruction_base) < (cpu.max_memory_needed + cpu.instruction_base)) 
+            {
+                int address = sim.config.paging ? pagedAddress(sim, cpu, current_instruction.operand_1, false) : current_instruction.operand_1 + cpu.instruction_base;
+                cpu.register_value = mainMemory[address];
+                if (sim.log_level >= LOG_INSTRUCTIONS)
+                {
+                    logEvent(*sim.log, cpu.clock, cpu.process_id, EVENT_LOADED, 4);
+                }
+            } 
+            else
+            {
+                if (sim.log_level >= LOG_INSTRUCTIONS)
+                {
+                    logEvent(*sim.log, cpu.clock, cpu.process_id, EVENT_LOAD_ERROR, 4);
+                }
+            }
+            cpu.CPU_cycles_used++;
+            cpu.clock++;
+            cpu.slice_used++;
+        }
+        // invalid opcode
+        else 
+        {
+            std::cerr << "ERROR: Invalid opcode " << current_op_code << "\n";
+        }
+
+        cpu.program_counter++; // increment program counter
+
+        // out of time with work still left: TimeOUT interrupt
+        if (cpu.slice_used >= cpu.time_slice && cpu.program_counter < cpu.num_instructions)
+        {
+            return EXIT_TIMEOUT;
+        }
+    } // END WHILE LOOP
+
+    return EXIT_TERMINATED;
+} // END FUNCTION
+
+// --profile: one more executed instruction of this opcode, nothing at all in the unprofiled interpreters
+template <bool Profiled>
+inline void countOpcode(Simulation &sim, int op_code)
+{
+    if constexpr (Profiled)
+    {
+        sim.profile->op_counts[(unsigned int)op_code <= 4u ? op_code : 0]++;
+    }
+} // END FUNCTION
+
+/*
+* Cycles a compute charges this time. Normally all of them, the slice is only checked once the instruction is done.
+* With --split-compute a compute that does not fit in what is left of the slice takes exactly the rest of the slice,
+* the remainder goes into compute_left and the next dispatch resumes the same instruction with it: one subtraction per
+* slice however long the compute is.
+*/
+inline int computeCycles(CPUState &cpu, int cycles, bool split_compute)
+{
+    if (cpu.compute_left > 0)
+    {
+        cycles = cpu.compute_left;
+    }
+
+    int left_in_slice = cpu.time_slice - cpu.slice_used;
+    if (split_compute && cycles > left_in_slice && left_in_slice > 0)
+    {
+        cpu.compute_left = cycles - left_in_slice;
+        return left_in_slice;
+    }
+
+    cpu.compute_left = 0;
+    return cycles;
+} // END FUNCTION
+
+/*
+* --paging: the mainMemory index of a logical address the caller has already bounds checked. A TLB hit is one compare,
+* a miss reads the page table, and only a page that is not resident goes to pageFault.
+*/
+inline int pagedAddress(Simulation &sim, CPUState &cpu, int address, bool store)
+{
+    PagedMemory &paged = sim.paged;
+    int page = cpu.page_table_base + (address >> paged.frame_shift);
+
+    TLBEntry &entry = paged.tlb[page & paged.tlb_mask];
+    if (entry.page == page)
+    {
+        paged.tlb_hits++;
+    }
+    else
+    {
+        paged.tlb_misses++;
+        int frame = paged.pageTable[page];
+        if (frame < 0)
+        {
+            frame = pageFault(sim, cpu, page, address);
+        }
+        entry.page = page;
+        entry.frame = frame;
+    }
+
+    PageFrame &frame = paged.frame[entry.frame];
+    frame.referenced = true;
+    frame.uses++;
+    frame.dirty |= store;
+    return (entry.frame << paged.frame_shift) + (address & paged.frame_mask);
+} // END FUNCTION
+
+// brings the page holding a logical address into a free frame, or a victim's, and charges the fault to the process's clock
+int pageFault(Simulation &sim, CPUState &cpu, int page, int address)
+{
+    PagedMemory &paged = sim.paged;
+
+    int frame;
+    if (!paged.freeFrames.empty())
+    {
+        frame = paged.freeFrames.back();
+        paged.freeFrames.pop_back();
+    }
+    else
+    {
+        frame = pageVictim(paged, sim.config.page_policy);
+        evictPage(sim, frame);
+        paged.evictions++;
+    }
+
+    int page_start = address & ~paged.frame_mask;
+    PageFrame &loaded = paged.frame[frame];
+    loaded.page = page;
+    loaded.backing_address = cpu.instruction_base + page_start;
+    loaded.words = std::min(sim.config.frame_size, cpu.max_memory_needed - page_start);
+    loaded.dirty = false;
+    loaded.referenced = true;
+    loaded.uses = 0;
+
+    int *frame_words = &sim.mainMemory[frame << paged.frame_shift];
+    const int *page_words = &paged.backingStore[loaded.backing_address];
+    std::copy(page_words, page_words + loaded.words, frame_words);
+    std::fill(frame_words + loaded.words, frame_words + sim.config.frame_size, -1);
+
+    // newest end of the fifo order
+    loaded.older = paged.newest;
+    loaded.newer = -1;
+    if (paged.newest >= 0)
+    {
+        paged.frame[paged.newest].newer = frame;
+    }
+    else
+    {
+        paged.oldest = frame;
+    }
+    paged.newest = frame;
+
+    paged.pageTable[page] = frame;
+    paged.faults++;
+    paged.fault_ticks += sim.config.page_fault_cost;
+    cpu.clock += sim.config.page_fault_cost;
+    cpu.slice_used += sim.config.page_fault_cost;
+    return frame;
+} // END FUNCTION
+
+/*
+* Picks the frame to replace, only called when every frame is in use. fifo is the head of the load order list and clock
+* is amortized constant time. lfu scans every frame for the fewest uses, starting after the last victim so ties rotate,
+* which costs O(frames) but only once per fault, never per access.
+*/
+int pageVictim(PagedMemory &paged, int page_policy)
+{
+    if (page_policy == PAGE_FIFO)
+    {
+        return paged.oldest;
+    }
+
+    if (page_policy == PAGE_CLOCK)
+    {
+        while (paged.frame[paged.hand].referenced)
+        {
+            paged.frame[paged.hand].referenced = false; // second chance
+            paged.hand = (paged.hand + 1) % paged.frames;
+        }
+        int victim = paged.hand;
+        paged.hand = (paged.hand + 1) % paged.frames;
+        return victim;
+    }
+
+    int victim = paged.hand;
+    for (int i = 1; i < paged.frames; i++)
+    {
+        int frame = (paged.hand + i) % paged.frames;
+        if (paged.frame[frame].uses < paged.frame[victim].uses)
+        {
+            victim = frame;
+        }
+    }
+    paged.hand = (victim + 1) % paged.frames;
+    return victim;
+} // END FUNCTION
+
+// empties a resident frame: its page is written back if it was stored to, then unmapped from the page table and the TLB
+void evictPage(Simulation &sim, int frame)
+{
+    PagedMemory &paged = sim.paged;
+    PageFrame &victim = paged.frame[frame];
+
+    if (victim.dirty)
+    {
+        const int *frame_words = &sim.mainMemory[frame << paged.frame_shift];
+        std::copy(frame_words, frame_words + victim.words, paged.backingStore.begin() + victim.backing_address);
+        paged.write_backs++;
+    }
+
+    paged.pageTable[victim.page] = -1;
+    TLBEntry &entry = paged.tlb[victim.page & paged.tlb_mask];
+    if (entry.page == victim.page)
+    {
+        entry.page = -1;
+    }
+
+    // out of the fifo order
+    if (victim.older >= 0)
+    {
+        paged.frame[victim.older].newer = victim.newer;
+    }
+    else
+    {
+        paged.oldest = victim.newer;
+    }
+    if (victim.newer >= 0)
+    {
+        paged.frame[victim.newer].older = victim.older;
+    }
+    else
+    {
+        paged.newest = victim.older;
+    }
+
+    victim.page = -1;
+    victim.referenced = false;
+} // END FUNCTION
+
+/*
+* Threaded interpreter core. Each handler fetches its own operands out of the decoded record, executes, and jumps
+* straight to the handler of the next instruction through the table, so there is one indirect jump per instruction
+* and no compare chain. Opcodes outside 1-4 are clamped to slot 0, the invalid opcode handler.
+* GCC and Clang get computed goto, everything else gets the same table shape as a switch.
+*/
+template <bool Profiled>
+int runThreaded(Simulation &sim, CPUState &cpu, const Instruction *code)
+{
+    const Instruction *current_instruction;
+    int *memory = sim.mainMemory.data();
+    int address;
+    int cycles;
+
+// slot for an opcode: itself when it is 1-4, 0 (invalid) otherwise. The unsigned compare also catches negatives
+#define OPCODE_SLOT(op) ((unsigned int)(op) <= 4u ? (op) : 0)
+
+// after a handler that used CPU time: TimeOUT interrupt if the slice is gone and there is work left
+#define END_OF_TICKING_INSTRUCTION()                                                            \
+    cpu.program_counter++;                                                                      \
+    if (cpu.slice_used >= cpu.time_slice && cpu.program_counter < cpu.num_instructions)         \
+    {                                                                                           \
+        return EXIT_TIMEOUT;                                                                    \
+    }
+
+// one event per executed instruction, only when the log level asks for them
+#define LOG_INSTRUCTION(type, op_code)                                              \
+    if (sim.log_level >= LOG_INSTRUCTIONS)                                          \
+    {                                                                               \
+        logEvent(*sim.log, cpu.clock, cpu.process_id, type, op_code);               \
+    }
+
+#ifdef USE_COMPUTED_GOTO
+    static void *dispatch_table[5] = { &&op_invalid, &&op_compute, &&op_print, &&op_store, &&op_load };
+
+#define DISPATCH()                                                          \
+    if (cpu.program_counter >= cpu.num_instructions)                        \
+    {                                                                       \
+        return EXIT_TERMINATED;                                             \
+    }                                                                       \
+    current_instruction = &code[cpu.program_counter];                       \
+    cpu.instructions++;                                                     \
+    countOpcode<Profiled>(sim, current_instruction->op_code);               \
+    goto *dispatch_table[OPCODE_SLOT(current_instruction->op_code)];
+
+    DISPATCH();
+
+op_compute:
+    cycles = computeCycles(cpu, current_instruction->operand_2, sim.config.split_compute);
+    cpu.CPU_cycles_used += cycles;
+    cpu.clock += cycles;
+    cpu.slice_used += cycles;
+    if (cpu.compute_left > 0)
+    {
+        return EXIT_TIMEOUT;
+    }
+    LOG_INSTRUCTION(EVENT_COMPUTE, 1);
+    END_OF_TICKING_INSTRUCTION();
+    DISPATCH();
+
+op_print:
+    cpu.CPU_cycles_used += current_instruction->operand_1;
+    cpu.IO_cycles = current_instruction->operand_1;
+    LOG_INSTRUCTION(EVENT_PRINT, 2);
+    cpu.program_counter++;
+    return EXIT_IO;
+
+op_store:
+    address = current_instruction->operand_2;
+    cpu.register_value = current_instruction->operand_1;
+    if (address >= 0 && address < cpu.max_memory_needed) // inside the process's logical memory
+    {
+        memory[sim.config.paging ? pagedAddress(sim, cpu, address, true) : cpu.instruction_base + address] = current_instruction->operand_1;
+        LOG_INSTRUCTION(EVENT_STORED, 3);
+    }
+    else
+    {
+        LOG_INSTRUCTION(EVENT_STORE_ERROR, 3);
+    }
+    cpu.CPU_cycles_used++;
+    cpu.clock++;
+    cpu.slice_used++;
+    END_OF_TICKING_INSTRUCTION();
+    DISPATCH();
+
+op_load:
+    address = current_instruction->operand_1;
+    if (address >= 0 && address < cpu.max_memory_needed)
+    {
+        cpu.register_value = memory[sim.config.paging ? pagedAddress(sim, cpu, address, false) : cpu.instruction_base + address];
+        LOG_INSTRUCTION(EVENT_LOADED, 4);
+    }
+    else
+    {
+        LOG_INSTRUCTION(EVENT_LOAD_ERROR, 4);
+    }
+    cpu.CPU_cycles_used++;
+    cpu.clock++;
+    cpu.slice_used++;
+    END_OF_TICKING_INSTRUCTION();
+    DISPATCH();
+
+op_invalid:
+    std::cerr << "ERROR: Invalid opcode " << current_instruction->op_code << "\n";
+    cpu.program_counter++;
+    DISPATCH();
+
+#undef DISPATCH
+#else
+    while (cpu.program_counter < cpu.num_instructions)
+    {
+        current_instruction = &code[cpu.program_counter];
+        cpu.instructions++;
+        countOpcode<Profiled>(sim, current_instruction->op_code);
+
+        switch (OPCODE_SLOT(current_instruction->op_code))
+        {
+        case 1: // compute
+            cycles = computeCycles(cpu, current_instruction->operand_2, sim.config.split_compute);
+            cpu.CPU_cycles_used += cycles;
+            cpu.clock += cycles;
+            cpu.slice_used += cycles;
+            if (cpu.compute_left > 0)
+            {
+                return EXIT_TIMEOUT;
+            }
+            LOG_INSTRUCTION(EVENT_COMPUTE, 1);
+            END_OF_TICKING_INSTRUCTION();
+            break;
+
+        case 2: // print
+            cpu.CPU_cycles_used += current_instruction->operand_1;
+            cpu.IO_cycles = current_instruction->operand_1;
+            LOG_INSTRUCTION(EVENT_PRINT, 2);
+            cpu.program_counter++;
+            return EXIT_IO;
+
+        case 3: // store
+            address = current_instruction->operand_2;
+            cpu.register_value = current_instruction->operand_1;
+            if (address >= 0 && address < cpu.max_memory_needed)
+            {
+                memory[sim.config.paging ? pagedAddress(sim, cpu, address, true) : cpu.instruction_base + address] = current_instruction->operand_1;
+                LOG_INSTRUCTION(EVENT_STORED, 3);
+            }
+            else
+            {
+                LOG_INSTRUCTION(EVENT_STORE_ERROR, 3);
+            }
+            cpu.CPU_cycles_used++;
+            cpu.clock++;
+            cpu.slice_used++;
+            END_OF_TICKING_INSTRUCTION();
+            break;
+
+        case 4: // load
+            address = current_instruction->operand_1;
+            if (address >= 0 && address < cpu.max_memory_needed)
+            {
+                cpu.register_value = memory[sim.config.paging ? pagedAddress(sim, cpu, address, false) : cpu.instruction_base + address];
+                LOG_INSTRUCTION(EVENT_LOADED, 4);
+            }
+            else
+            {
+                LOG_INSTRUCTION(EVENT_LOAD_ERROR, 4);
+            }
+            cpu.CPU_cycles_used++;
+            cpu.clock++;
+            cpu.slice_used++;
+            END_OF_TICKING_INSTRUCTION();
+            break;
+
+        default: // invalid opcode
+            std::cerr << "ERROR: Invalid opcode " << current_instruction->op_code << "\n";
+            cpu.program_counter++;
+            break;
+        }
+    }
+    return EXIT_TERMINATED;
+#endif
+
+#undef LOG_INSTRUCTION
+#undef END_OF_TICKING_INSTRUCTION
+#undef OPCODE_SLOT
+} // END FUNCTION
+
+// moves every job whose I/O has finished by the current CPU_clock back to the readyQueue, earliest finisher first
+template <bool Profiled>
+void checkIOWaitingQueue(Simulation &sim)
+{
+    unsigned long long started = 0;
+    if constexpr (Profiled)
+    {
+        started = hostTicks();
+    }
+
+    while (!sim.IOWaitingQueue.empty() && sim.IOWaitingQueue.top().completion_time <= sim.CPU_clock)
+    {
+        IOWaitEntry entry = sim.IOWaitingQueue.top();
+        sim.IOWaitingQueue.pop();
+
+        HotPCB &pcb = sim.pcbTable[entry.slot];
+        pcb.state = STATE_READY;
+        mirrorPCB(sim, entry.slot);
+        sim.processes[entry.slot].IO_wait_time += sim.CPU_clock - entry.entered_time;
+        recordLatency(sim.metrics.IO_wait, sim.CPU_clock - entry.entered_time);
+        pushReady(sim, entry.slot);
+
+        if (sim.log_level >= LOG_TRANSITIONS)
+        {
+            logEvent(*sim.log, sim.CPU_clock, pcb.process_id, EVENT_IO_DONE, 0);
+        }
+    }
+
+    if constexpr (Profiled)
+    {
+        sim.profile->io_ticks += hostTicks() - started;
+    }
+} // END FUNCTION
+
+void show_main_memory(std::vector<int> &mainMemory, int rows) 
+{
+    std::string text;
+    text.reserve(rows * 16);
+    for (int i = 0; i < rows; i++)
+    {
+        appendInt(text, i);
+        text += ": ";
+        appendInt(text, mainMemory[i]);
+        text += '\n';
+    }
+    text += '\n';
+    writeText(text);
+} // END FUNCTION
+
+/*
+* Formats memory for --memory-dump into text. DUMP_FULL is the classic word per line; DUMP_RLE folds every run of
+* DUMP_MIN_RUN or more equal words into "first-last : value", so a mostly free memory is a handful of lines. The digits
+* go straight into the one buffer through appendInt's to_chars, no stream formatting per word.
+*/
+void appendMemoryDump(std::string &text, const int *memory, int size, int mode)
+{
+    text.reserve(text.size() + (mode == DUMP_FULL ? (size_t)size * 16 : 4096));
+    int i = 0;
+    while (i < size)
+    {
+        int run_end = i + 1;
+        if (mode == DUMP_RLE)
+        {
+            while (run_end < size && memory[run_end] == memory[i])
+            {
+                run_end++;
+            }
+        }
+
+        if (run_end - i >= DUMP_MIN_RUN)
+        {
+            appendInt(text, i);
+            text += '-';
+            appendInt(text, run_end - 1);
+            text += " : ";
+            appendInt(text, memory[i]);
+            text += '\n';
+            i = run_end;
+            continue;
+        }
+
+        for (; i < run_end; i++)
+        {
+            appendInt(text, i);
+            text += " : ";
+            appendInt(text, memory[i]);
+            text += '\n';
+        }
+    }
+} // END FUNCTION
+
+/*
+* --memory-diff: every word that differs between two snapshots of the same size, as "address : before -> after", and a
+* count at the end. The stretches that did not change are skipped 8 words a step by scanMemory.
+*/
+void appendMemoryDiff(std::string &text, const int *before, const int *after, int size)
+{
+    long long changed_words = 0;
+    long long changed_runs = 0;
+    int i = scanMemory(before, after, 0, size, false);
+    while (i < size)
+    {
+        int run_end = scanMemory(before, after, i, size, true);
+        changed_words += run_end - i;
+        changed_runs++;
+        for (; i < run_end; i++)
+        {
+            appendInt(text, i);
+            text += " : ";
+            appendInt(text, before[i]);
+            text += " -> ";
+            appendInt(text, after[i]);
+            text += '\n';
+        }
+        i = scanMemory(before, after, run_end, size, false);
+    }
+
+    text += "memory diff: ";
+    appendInt(text, changed_words);
+    text += " words changed in ";
+    appendInt(text, changed_runs);
+    text += " runs\n";
+} // END FUNCTION
+
+// first index from from on where a and b are equal (equal = true) or differ (equal = false), size if there is none
+int scanMemory(const int *a, const int *b, int from, int size, bool equal)
+{
+    int i = from;
+#if defined(__SSE2__)
+    // 8 words a step: two 4 word compares, one bit per word in mask, set where the words are equal
+    int wanted = equal ? 0 : 0xFF; // a mask of all the other kind, nothing to stop for
+    for (; i + 8 <= size; i += 8)
+    {
+        __m128i low = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+        __m128i high = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(a + i + 4)), _mm_loadu_si128((const __m128i *)(b + i + 4)));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(low)) | (_mm_movemask_ps(_mm_castsi128_ps(high)) << 4);
+        if (mask != wanted)
+        {
+            return i + __builtin_ctz(equal ? mask : ~mask);
+        }
+    }
+#endif
+    for (; i < size; i++)
+    {
+        if ((a[i] == b[i]) == equal)
+        {
+            return i;
+        }
+    }
+    return size;
+} // END FUNCTION
+
+// text that was built in one buffer goes to stdout in one write, behind anything std::cout still holds
+void writeText(const std::string &text)
+{
+    std::cout.flush();
+    fwrite(text.data(), 1, text.size(), stdout);
+    fflush(stdout);
+} // END FUNCTION
+
+// --memory-stats: how well main memory was shared out over the run
+void show_memory_stats(const Simulation &sim)
+{
+    const MemoryAllocator &memory = sim.memory;
+
+    // admission latency from the newJobQueue histogram, it has every admission even once --stream has reused the slot
+    const LatencyHistogram &admission = sim.metrics.new_job_wait;
+
+    std::cout << "memory capacity: " << memory.capacity << " words, peak in use: " << memory.peak_words_in_use << "\n";
+    std::cout << "allocations: " << memory.allocations << ", frees: " << memory.frees << ", rejected jobs: " << sim.rejected_jobs << "\n";
+    std::cout << "failed admissions: " << memory.failed_admissions
+              << ", average fragmentation when blocked: " << (memory.failed_admissions > 0 ? memory.fragmentation_sum / memory.failed_admissions : 0)
+              << ", worst: " << memory.worst_fragmentation << "\n";
+    std::cout << "jobs that waited for memory: " << admission.count - admission.counts[0]
+              << ", average admission latency: " << (admission.count == 0 ? 0 : (double)admission.sum / admission.count)
+              << ", max: " << admission.max << "\n";
+    if (sim.stream)
+    {
+        std::cout << "streamed jobs read: " << sim.stream->jobs_read << ", most live at once: " << sim.stream->peak_live_jobs
+                  << ", process slots used: " << sim.pcbTable.size() << "\n";
+    }
+} // END FUNCTION
+
+// --memory-stats with --paging: TLB and page fault numbers instead of the allocator's
+void show_paging_stats(const Simulation &sim)
+{
+    const PagedMemory &paged = sim.paged;
+    long long lookups = paged.tlb_hits + paged.tlb_misses;
+
+    std::cout << "paging: " << page_policy_names[sim.config.page_policy] << ", " << paged.frames << " frames of " << sim.config.frame_size << " words, "
+              << paged.tlb.size() << " entry TLB, " << paged.pageTable.size() << " pages over " << sim.processes.size() << " processes" << "\n";
+    std::cout << "TLB hits: " << paged.tlb_hits << ", misses: " << paged.tlb_misses
+              << ", hit rate: " << (lookups > 0 ? 100.0 * paged.tlb_hits / lookups : 0) << "%" << "\n";
+    std::cout << "page faults: " << paged.faults << ", ticks charged: " << paged.fault_ticks
+              << ", evictions: " << paged.evictions << ", dirty write backs: " << paged.write_backs << "\n";
+} // END FUNCTION
+
+// SIGUSR1: only raises the flag, the simulation writes the checkpoint at its next dispatch
+void requestCheckpoint(int)
+{
+    checkpoint_requested = 1;
+} // END FUNCTION
+
+void clearHistogram(LatencyHistogram &histogram)
+{
+    std::fill(histogram.counts, histogram.counts + HISTOGRAM_BUCKETS, 0);
+    histogram.count = 0;
+    histogram.sum = 0;
+    histogram.max = 0;
+} // END FUNCTION
+
+inline void recordLatency(LatencyHistogram &histogram, int value)
+{
+    histogram.counts[histogramBucket(value)]++;
+    histogram.count++;
+    histogram.sum += value;
+    histogram.max = std::max(histogram.max, value);
+} // END FUNCTION
+
+inline int histogramBucket(int value)
+{
+    if (value < HISTOGRAM_LINEAR)
+    {
+        return value < 0 ? 0 : value;
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    int top_bit = 31 - __builtin_clz((unsigned int)value); // 5 or more here
+#else
+    int top_bit = 5;
+    while ((value >> (top_bit + 1)) != 0)
+    {
+        top_bit++;
+    }
+#endif
+    int shift = top_bit - 4;                               // keeps the top 5 bits, 16..31
+    return HISTOGRAM_LINEAR + (shift - 1) * HISTOGRAM_SUB_BUCKETS + ((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+} // END FUNCTION
+
+// smallest value that lands in a bucket
+int bucketLowerBound(int bucket)
+{
+    if (bucket < HISTOGRAM_LINEAR)
+    {
+        return bucket;
+    }
+
+    int shift = (bucket - HISTOGRAM_LINEAR) / HISTOGRAM_SUB_BUCKETS + 1;
+    int sub_bucket = (bucket - HISTOGRAM_LINEAR) % HISTOGRAM_SUB_BUCKETS;
+    return (HISTOGRAM_SUB_BUCKETS + sub_bucket) << shift;
+} // END FUNCTION
+
+// lower bound of the bucket holding the given percentile, the exact max for 100
+int histogramPercentile(const LatencyHistogram &histogram, double percentile)
+{
+    if (histogram.count == 0)
+    {
+        return 0;
+    }
+    if (percentile >= 100)
+    {
+        return histogram.max;
+    }
+
+    long long rank = std::max(1LL, (long long)(histogram.count * percentile / 100.0 + 0.5));
+    long long seen = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+    {
+        seen += histogram.counts[bucket];
+        if (seen >= rank)
+        {
+            return bucketLowerBound(bucket);
+        }
+    }
+    return histogram.max;
+} // END FUNCTION
+
+/*
+* --metrics: one row per process (termination logging plus the counters) and the per queue histograms, as CSV or as
+* one JSON object. CSV has two tables separated by a blank line, the histogram table lists the non empty buckets.
+*/
+bool writeMetrics(const std::string &path, int format, const Simulation &sim)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "ERROR: could not create metrics file " << path << "\n";
+        return false;
+    }
+
+    const char *const names[] = { "new_job_wait", "ready_wait", "io_wait", "response", "turnaround" };
+    const LatencyHistogram *const histograms[] = { &sim.metrics.new_job_wait, &sim.metrics.ready_wait, &sim.metrics.IO_wait,
+                                                   &sim.metrics.response, &sim.metrics.turnaround };
+    const int num_histograms = 5;
+
+    // with --stream the slots have been reused many times over, only the queue histograms cover every process
+    size_t process_rows = sim.stream ? 0 : sim.processes.size();
+    long long total_cycles = sim.stream ? sim.stream->finished_cycles : 0;
+    for (size_t i = 0; i < process_rows; i++)
+    {
+        total_cycles += sim.pcbTable[i].CPU_cycles_used;
+    }
+
+    if (format == METRICS_CSV)
+    {
+        out << "pid,admitted,first_run,completion,execution_time,waiting_time,io_wait_time,context_switches,timeouts,io_waits,cpu_cycles_used\n";
+        for (size_t i = 0; i < process_rows; i++)
+        {
+            const HotPCB &pcb = sim.pcbTable[i];
+            const ProcessRecord &record = sim.processes[i];
+            out << pcb.process_id << "," << record.admitted_time << "," << pcb.first_run_time << "," << record.completion_time << ","
+                << (record.completion_time >= 0 ? record.completion_time - pcb.first_run_time : -1) << ","
+                << pcb.waiting_time << "," << record.IO_wait_time << "," << pcb.context_switches << ","
+                << record.timeouts << "," << record.IO_waits << "," << pcb.CPU_cycles_used << "\n";
+        }
+
+        out << "\nqueue,count,mean,p50,p90,p99,max\n";
+        for (int h = 0; h < num_histograms; h++)
+        {
+            const LatencyHistogram &histogram = *histograms[h];
+            out << names[h] << "," << histogram.count << "," << (histogram.count > 0 ? (double)histogram.sum / histogram.count : 0) << ","
+                << histogramPercentile(histogram, 50) << "," << histogramPercentile(histogram, 90) << ","
+                << histogramPercentile(histogram, 99) << "," << histogram.max << "\n";
+        }
+
+        out << "\nqueue,bucket_low,count\n";
+        for (int h = 0; h < num_histograms; h++)
+        {
+            for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+            {
+                if (histograms[h]->counts[bucket] > 0)
+                {
+                    out << names[h] << "," << bucketLowerBound(bucket) << "," << histograms[h]->counts[bucket] << "\n";
+                }
+            }
+        }
+        out << "\ntotal_cpu_time," << sim.CPU_clock << "\ntotal_cpu_cycles_used," << total_cycles << "\n";
+    }
+    else
+    {
+        out << "{\"total_cpu_time\":" << sim.CPU_clock << ",\"total_cpu_cycles_used\":" << total_cycles << ",\"processes\":[";
+        for (size_t i = 0; i < process_rows; i++)
+        {
+            const HotPCB &pcb = sim.pcbTable[i];
+            const ProcessRecord &record = sim.processes[i];
+            out << (i > 0 ? ",\n" : "\n") << "{\"pid\":" << pcb.process_id << ",\"admitted\":" << record.admitted_time
+                << ",\"first_run\":" << pcb.first_run_time << ",\"completion\":" << record.completion_time
+                << ",\"waiting_time\":" << pcb.waiting_time << ",\"io_wait_time\":" << record.IO_wait_time
+                << ",\"context_switches\":" << pcb.context_switches << ",\"timeouts\":" << record.timeouts
+                << ",\"io_waits\":" << record.IO_waits << ",\"cpu_cycles_used\":" << pcb.CPU_cycles_used << "}";
+        }
+        out << "],\n\"queues\":{";
+        for (int h = 0; h < num_histograms; h++)
+        {
+            const LatencyHistogram &histogram = *histograms[h];
+            out << (h > 0 ? ",\n" : "\n") << "\"" << names[h] << "\":{\"count\":" << histogram.count
+                << ",\"mean\":" << (histogram.count > 0 ? (double)histogram.sum / histogram.count : 0)
+                << ",\"p50\":" << histogramPercentile(histogram, 50) << ",\"p90\":" << histogramPercentile(histogram, 90)
+                << ",\"p99\":" << histogramPercentile(histogram, 99) << ",\"max\":" << histogram.max << ",\"buckets\":[";
+
+            bool first = true;
+            for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+            {
+                if (histogram.counts[bucket] == 0)
+                {
+                    continue;
+                }
+                out << (first ? "" : ",") << "[" << bucketLowerBound(bucket) << "," << histogram.counts[bucket] << "]";
+                first = false;
+            }
+            out << "]}";
+        }
+        out << "}}\n";
+    }
+
+    return (bool)out;
+} // END FUNCTION
+
+// SMP: where each core's ticks went, up to the end of the whole run
+void show_core_stats(const Simulation &sim)
+{
+    std::cout << std::setw(6) << "cpu" << std::setw(12) << "busy" << std::setw(12) << "switching" << std::setw(12) << "idle"
+              << std::setw(13) << "utilisation" << std::setw(12) << "dispatches" << std::setw(10) << "steals" << std::setw(12) << "migrations" << "\n";
+
+    for (size_t c = 0; c < sim.cores.size(); c++)
+    {
+        const Core &core = sim.cores[c];
+        double utilisation = sim.CPU_clock > 0 ? 100.0 * core.busy_ticks / sim.CPU_clock : 0;
+
+        std::cout << std::setw(6) << c << std::setw(12) << core.busy_ticks << std::setw(12) << core.switch_ticks
+                  << std::setw(12) << core.idle_ticks + (sim.CPU_clock - core.clock) << std::fixed << std::setprecision(1)
+                  << std::setw(12) << utilisation << "%" << std::setw(12) << core.dispatches << std::setw(10) << core.steals
+                  << std::setw(12) << core.migrations << "\n";
+    }
+} // END FUNCTION
+
+// --profile clock: the time stamp counter where there is one, it costs a few nanoseconds to read
+inline unsigned long long hostTicks()
+{
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+} // END FUNCTION
+
+// charges the host ticks since the last phase ended to phase
+void endProfilePhase(Profile &profile, int phase)
+{
+    unsigned long long now = hostTicks();
+    profile.phase_ticks[phase] += now - profile.mark;
+    profile.mark = now;
+} // END FUNCTION
+
+/*
+* --profile: the flat profile on stderr, one line per place host time went with its own ticks (the ones not in a line
+* below it), then executed instructions by opcode and the processes that took the most host time per simulated cycle
+* used. Every line of the folded stack file is the same own ticks under its full path.
+*/
+bool reportProfile(const Simulation &sim, const std::string &path)
+{
+    const Profile &profile = *sim.profile;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - profile.start_time).count();
+    unsigned long long elapsed = hostTicks() - profile.start_ticks;
+    double ticks_per_second = seconds > 0 ? elapsed / seconds : 0;
+
+    // own ticks, clamped: counters read on different cores can be a few ticks out
+    auto own = [](unsigned long long total, unsigned long long inside) { return total > inside ? total - inside : 0ULL; };
+    unsigned long long run_own = own(profile.phase_ticks[PROFILE_RUN], profile.select_ticks + profile.idle_io_ticks + profile.slice_ticks);
+    unsigned long long slice_own = own(profile.slice_ticks, profile.interpret_ticks + profile.slice_io_ticks);
+
+    struct ProfileLine
+    {
+        const char *stack;
+        const char *name;
+        unsigned long long ticks;
+    };
+    ProfileLine lines[] = {
+        { "simulator;parse", "parse", profile.phase_ticks[PROFILE_PARSE] },
+        { "simulator;load", "load", profile.phase_ticks[PROFILE_LOAD] },
+        { "simulator;dump", "memory dump", profile.phase_ticks[PROFILE_DUMP] },
+        { "simulator;run", "run loop", run_own },
+        { "simulator;run;select", "scheduler select", profile.select_ticks },
+        { "simulator;run;io_wakeup", "I/O wakeups while idle", profile.idle_io_ticks },
+        { "simulator;run;slice", "context switch in and out", slice_own },
+        { "simulator;run;slice;io_wakeup", "I/O wakeups at slice ends", profile.slice_io_ticks },
+        { "simulator;run;slice;interpret", "interpreter", profile.interpret_ticks },
+        { "simulator;report", "report", profile.phase_ticks[PROFILE_REPORT] },
+    };
+    const int line_count = sizeof(lines) / sizeof(lines[0]);
+
+    unsigned long long total = 0;
+    for (int i = 0; i < line_count; i++)
+    {
+        total += lines[i].ticks;
+    }
+
+    std::cerr << "profile: " << seconds << " host seconds, " << total << " ticks" << (ticks_per_second > 0 ? "" : " (no clock rate)")
+              << ", " << profile.slices << " slices, " << profile.selects << " scheduler picks" << "\n";
+    for (int i = 0; i < line_count; i++)
+    {
+        std::cerr << std::setw(28) << std::left << lines[i].name << std::right
+                  << std::setw(16) << lines[i].ticks
+                  << std::setw(8) << std::fixed << std::setprecision(2) << (total > 0 ? 100.0 * lines[i].ticks / total : 0) << "%"
+                  << std::setw(12) << std::setprecision(6) << (ticks_per_second > 0 ? lines[i].ticks / ticks_per_second : 0) << " s" << "\n";
+    }
+    std::cerr.unsetf(std::ios::floatfield);
+    std::cerr << std::setprecision(6);
+
+    const char *const op_names[] = { "invalid", "compute", "print", "store", "load" };
+    std::cerr << "instructions:";
+    for (int op = 1; op <= 4; op++)
+    {
+        std::cerr << " " << op_names[op] << " " << profile.op_counts[op];
+    }
+    std::cerr << ", " << op_names[0] << " " << profile.op_counts[0] << "\n";
+
+    // host time per simulated cycle, the processes that cost the most to simulate first
+    std::vector<int> slots;
+    for (size_t slot = 0; slot < profile.process_ticks.size(); slot++)
+    {
+        if (profile.process_ticks[slot] > 0)
+        {
+            slots.push_back(slot);
+        }
+    }
+    auto per_cycle = [&profile, &sim](int slot) { return (double)profile.process_ticks[slot] / std::max(1, sim.pcbTable[slot].CPU_cycles_used); };
+    std::sort(slots.begin(), slots.end(), [&per_cycle](int a, int b) { return per_cycle(a) > per_cycle(b); });
+    for (size_t i = 0; i < slots.size() && i < 10; i++)
+    {
+        int slot = slots[i];
+        std::cerr << "process " << sim.pcbTable[slot].process_id << ": " << sim.pcbTable[slot].CPU_cycles_used << " simulated cycles, "
+                  << profile.process_ticks[slot] << " host ticks, " << per_cycle(slot) << " per cycle" << "\n";
+    }
+
+    std::string folded;
+    for (int i = 0; i < line_count; i++)
+    {
+        if (lines[i].ticks == 0)
+        {
+            continue;
+        }
+        // the interpreter's ticks are all split out by process below
+        if (std::string(lines[i].name) == "interpreter")
+        {
+            continue;
+        }
+        folded += lines[i].stack;
+        folded += ' ';
+        appendInt(folded, lines[i].ticks);
+        folded += '\n';
+    }
+    for (size_t slot = 0; slot < profile.process_ticks.size(); slot++)
+    {
+        if (profile.process_ticks[slot] > 0)
+        {
+            folded += "simulator;run;slice;interpret;process ";
+            appendInt(folded, sim.pcbTable[slot].process_id);
+            folded += ' ';
+            appendInt(folded, profile.process_ticks[slot]);
+            folded += '\n';
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out || !out.write(folded.data(), folded.size()))
+    {
+        std::cerr << "ERROR: could not write profile " << path << "\n";
+        return false;
+    }
+    return true;
+} // END FUNCTION
+
+/*
+* --log-level 0: the termination lines and the total CPU time the event log would have printed, in the same format,
+* built from the pcbTable once the run is over. Processes come by termination clock (with --cpus the live log may order
+* cores that finish close together differently). With --stream the slots have been reused, so only the total is left.
+*/
+void show_run_summary(const Simulation &sim, int format)
+{
+    std::vector<int> finished;
+    for (size_t slot = 0; slot < sim.processes.size() && !sim.stream; slot++)
+    {
+        if (sim.processes[slot].completion_time >= 0)
+        {
+            finished.push_back(slot);
+        }
+    }
+    std::stable_sort(finished.begin(), finished.end(), [&sim](int a, int b) { return sim.processes[a].completion_time < sim.processes[b].completion_time; });
+
+    std::string text;
+    EventRecord event;
+    event.waited = 0;
+    for (size_t i = 0; i < finished.size(); i++)
+    {
+        event.clock = sim.processes[finished[i]].completion_time;
+        event.process_id = sim.pcbTable[finished[i]].process_id;
+        event.type = EVENT_TERMINATED;
+        event.value = sim.pcbTable[finished[i]].first_run_time;
+        formatEvent(event, format, text);
+    }
+    event.clock = sim.CPU_clock;
+    event.process_id = 0;
+    event.type = EVENT_FINISHED;
+    event.value = 0;
+    formatEvent(event, format, text);
+    writeText(text);
+} // END FUNCTION